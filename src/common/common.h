@@ -13,6 +13,7 @@
 #include <cstddef>
 #include <type_traits>
 
+using u64 = uint64_t;
 using u32 = uint32_t;
 using u16 = uint16_t;
 using u8 = uint8_t;
@@ -164,6 +165,8 @@ struct Position
   Position& operator+=(Direction dir) { x += directions[dir][0]; y += directions[dir][1]; return *this; }
   Position operator+(Direction dir) const { return Position(x + directions[dir][0], y + directions[dir][1]); }
   Position operator+(const Position& o) const { return Position(type, x + o.x, y + o.y); }
+  bool operator==(const Position& o) const { return type == o.type && x == o.x && y == o.y; }
+  bool operator!=(const Position& o) const { return !(*this == o); }
   
   static Position invalid() { return Position(Position::Type::INVALID); }
   static const s8 directions[8][2];
@@ -0,0 +1,296 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr u32 PIECES_PER_WORD = sizeof(u64) / sizeof(Piece);
+static_assert(sizeof(u64) % sizeof(Piece) == 0, "pieces must pack in words");
+
+BatchTracer::BatchTracer(u32 width, u32 height, u32 invWidth, u32 invHeight) :
+  width(width), height(height), heads(width*height, NO_VARIANT), visited(width*height*64, 0),
+  hits(width*height), failing(0), stranded(0), fallback(width, height, invWidth, invHeight)
+{
+
+}
+
+bool BatchTracer::prepare(const FieldState* states, u32 count)
+{
+  const TransitionTable& table = TransitionTable::instance();
+  const size_t tiles = width*height;
+  const std::vector<Piece>& first = states[0].pieces;
+
+  variants.clear();
+  goalTiles.clear();
+  failing = 0;
+  stranded = 0;
+
+  auto add = [this, &table] (const Piece& piece, u64 lanes) {
+    const u16 row = piece.empty() ? Board::EMPTY_ROW : table.row(piece.type(), piece.rotation(), piece.color());
+    variants.push_back({ lanes, row, piece.type(), piece.rotation(), piece.color(), NO_VARIANT });
+    return row != TransitionTable::NO_ROW;
+  };
+
+  bool tabulated = true;
+
+  for (u32 i = 0; i < tiles; ++i)
+  {
+    heads[i] = static_cast<u32>(variants.size());
+    tabulated &= add(first[i], count == LANES ? ~u64(0) : (u64(1) << count) - 1);
+  }
+
+  // a goal left in the inventory can't receive any beam
+  auto strands = [] (const Piece& piece) { return piece.isGoal() && piece.color() != LaserColor::NONE ? 1 : 0; };
+  const s32 firstStranded = static_cast<s32>(std::count_if(first.begin() + tiles, first.end(), strands));
+
+  if (firstStranded)
+    stranded = 1;
+
+  for (u32 lane = 1; lane < count; ++lane)
+  {
+    const std::vector<Piece>& pieces = states[lane].pieces;
+    const u64 bit = u64(1) << lane;
+    s32 goals = firstStranded;
+
+    assert(pieces.size() == first.size());
+
+    // pieces are compared a word at a time, boards of a batch usually differ on a tile or two; the copies have a
+    // constant size so that they compile to plain loads
+    const u8* bytes = reinterpret_cast<const u8*>(pieces.data());
+    const u8* firstBytes = reinterpret_cast<const u8*>(first.data());
+    const u32 words = static_cast<u32>(pieces.size()) / PIECES_PER_WORD;
+
+    auto differs = [&] (u32 i) {
+      const Piece& piece = pieces[i];
+
+      if (piece == first[i])
+        return;
+      else if (i >= tiles)
+      {
+        goals += strands(piece) - strands(first[i]);
+        return;
+      }
+
+      // flags don't change how a piece traces, a piece which only differs by them shares the variant
+      u32 v = heads[i], last = NO_VARIANT;
+      while (v != NO_VARIANT && (variants[v].type != piece.type() || variants[v].rotation != piece.rotation() || variants[v].color != piece.color()))
+        last = v, v = variants[v].next;
+
+      if (v == heads[i])
+        return;
+
+      variants[heads[i]].lanes &= ~bit;
+
+      if (v != NO_VARIANT)
+        variants[v].lanes |= bit;
+      else
+      {
+        variants[last].next = static_cast<u32>(variants.size());
+        tabulated &= add(piece, bit);
+      }
+    };
+
+    for (u32 word = 0; word < words; ++word)
+    {
+      u64 value, firstValue;
+      memcpy(&value, bytes + word*sizeof(u64), sizeof(u64));
+      memcpy(&firstValue, firstBytes + word*sizeof(u64), sizeof(u64));
+
+      if (value != firstValue)
+        for (u32 i = word*PIECES_PER_WORD; i < (word + 1)*PIECES_PER_WORD; ++i)
+          differs(i);
+    }
+
+    for (u32 i = words*PIECES_PER_WORD; i < pieces.size(); ++i)
+      differs(i);
+
+    if (goals)
+      stranded |= bit;
+  }
+
+  for (u32 i = 0; i < tiles; ++i)
+    for (u32 v = heads[i]; v != NO_VARIANT; v = variants[v].next)
+      if (variants[v].type == PIECE_STRICT_GOAL || variants[v].type == PIECE_LOOSE_GOAL)
+      {
+        goalTiles.push_back(i);
+        hits[i].fill(0);
+        break;
+      }
+
+  return tabulated;
+}
+
+void BatchTracer::push(s32 x, s32 y, Direction direction, LaserColor color, u64 lanes)
+{
+  if (x >= 0 && x < s32(width) && y >= 0 && y < s32(height))
+    beams.push_back({ x, y, direction, color, lanes });
+}
+
+void BatchTracer::enter(const Beam& beam, const Variant& variant, u64 lanes)
+{
+  const Transition& transition = TransitionTable::instance().at(variant.row, beam.direction, beam.color);
+
+  if (transition.blocked())
+    return;
+
+  if (transition.flags & Transition::GOAL)
+  {
+    std::array<u64, 11>& hit = hits[beam.y*width + beam.x];
+    hit[beam.direction] |= lanes;
+
+    for (u32 channel = 0; channel < 3; ++channel)
+      if (beam.color & (1 << channel))
+        hit[8 + channel] |= lanes;
+  }
+
+  if (transition.flags & Transition::FAIL)
+    failing |= lanes;
+
+  for (u8 i = 0; i < transition.count; ++i)
+  {
+    const Direction direction = Transition::direction(transition.beams[i]);
+    push(beam.x + Position::directions[direction][0], beam.y + Position::directions[direction][1], direction, Transition::color(transition.beams[i]), lanes);
+  }
+
+  if (transition.continues())
+  {
+    const Direction direction = Transition::direction(transition.next);
+    push(beam.x + Position::directions[direction][0], beam.y + Position::directions[direction][1], direction, Transition::color(transition.next), lanes);
+  }
+}
+
+void BatchTracer::trace()
+{
+  for (u32 slot : touched)
+    visited[slot] = 0;
+  touched.clear();
+
+  for (u32 i = 0; i < width*height; ++i)
+    for (u32 v = heads[i]; v != NO_VARIANT; v = variants[v].next)
+    {
+      const Variant& variant = variants[v];
+
+      if (variant.type == PIECE_SOURCE && variant.color != LaserColor::NONE)
+        push(i % width + Position::directions[variant.rotation][0], i / width + Position::directions[variant.rotation][1], variant.rotation, variant.color, variant.lanes);
+    }
+
+  while (!beams.empty())
+  {
+    Beam beam = beams.back();
+    beams.pop_back();
+
+    while (beam.x >= 0 && beam.x < s32(width) && beam.y >= 0 && beam.y < s32(height))
+    {
+      const u32 index = beam.y*width + beam.x;
+      const u32 slot = (index*8 + beam.direction)*8 + beam.color;
+
+      // each (tile, direction, color) is traced at most once by each board, as Field does for each source
+      const u64 lanes = beam.lanes & ~visited[slot];
+
+      if (!lanes)
+        break;
+      else if (!visited[slot])
+        touched.push_back(slot);
+
+      visited[slot] |= lanes;
+
+      u64 passing = 0;
+
+      for (u32 v = heads[index]; v != NO_VARIANT; v = variants[v].next)
+      {
+        const Variant& variant = variants[v];
+        const u64 entering = variant.lanes & lanes;
+
+        if (!entering)
+          continue;
+        else if (variant.row == Board::EMPTY_ROW)
+          passing |= entering;
+        else
+          enter(beam, variant, entering);
+      }
+
+      if (!passing)
+        break;
+
+      beam.lanes = passing;
+      beam.x += Position::directions[beam.direction][0];
+      beam.y += Position::directions[beam.direction][1];
+    }
+  }
+}
+
+void BatchTracer::collect(u32 count, BatchResult* results) const
+{
+  u64 unsatisfied = stranded;
+
+  for (u32 lane = 0; lane < count; ++lane)
+    results[lane] = { false, ((failing >> lane) & 1) != 0, 0 };
+
+  for (u32 tile : goalTiles)
+  {
+    const std::array<u64, 11>& hit = hits[tile];
+    const u64 axes[4] = { hit[0] | hit[4], hit[1] | hit[5], hit[2] | hit[6], hit[3] | hit[7] };
+    const u64 any = axes[0] | axes[1] | axes[2] | axes[3];
+    const u64 several = (axes[0] & (axes[1] | axes[2] | axes[3])) | (axes[1] & (axes[2] | axes[3])) | (axes[2] & axes[3]);
+    const u64 colored = hit[8] | hit[9] | hit[10];
+
+    for (u32 v = heads[tile]; v != NO_VARIANT; v = variants[v].next)
+    {
+      const Variant& variant = variants[v];
+
+      if (variant.type != PIECE_STRICT_GOAL && variant.type != PIECE_LOOSE_GOAL)
+        continue;
+
+      // same rules as Field::settleGoals(), a goal without color wants no beam at all
+      u64 satisfied;
+
+      if (variant.color == LaserColor::NONE)
+        satisfied = ~colored & ~any;
+      else
+      {
+        satisfied = any & ~several;
+        for (u32 channel = 0; channel < 3; ++channel)
+          satisfied &= (variant.color & (1 << channel)) ? hit[8 + channel] : ~hit[8 + channel];
+      }
+
+      satisfied &= variant.lanes;
+      unsatisfied |= variant.lanes & ~satisfied;
+
+      for (u64 lanes = satisfied; lanes; lanes &= lanes - 1)
+        ++results[Bitboard::lowest(lanes)].satisfied;
+    }
+  }
+
+  for (u32 lane = 0; lane < count; ++lane)
+    results[lane].won = !((unsatisfied >> lane) & 1);
+}
+
+void BatchTracer::evaluate(const FieldState* states, size_t count, BatchResult* results)
+{
+  for (size_t base = 0; base < count; base += LANES)
+  {
+    const u32 lanes = static_cast<u32>(std::min<size_t>(LANES, count - base));
+
+    if (prepare(states + base, lanes))
+    {
+      trace();
+      collect(lanes, results + base);
+      continue;
+    }
+
+    for (u32 lane = 0; lane < lanes; ++lane)
+    {
+      fallback.restore(states[base + lane]);
+
+      BatchResult& result = results[base + lane];
+      result.won = fallback.isWon();
+      result.failing = fallback.isFailing();
+      result.satisfied = static_cast<u32>(std::count_if(fallback.goalStates().begin(), fallback.goalStates().end(), [] (const GoalState& goal) { return goal.satisfied; }));
+    }
+  }
+}
+
+void BatchTracer::evaluate(const std::vector<FieldState>& states, std::vector<BatchResult>& results)
+{
+  results.resize(states.size());
+  evaluate(states.data(), states.size(), results.data());
+}
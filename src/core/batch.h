@@ -0,0 +1,78 @@
+#pragma once
+
+#include "level.h"
+
+#include <vector>
+
+/* outcome of a board of a batch, as Field::isWon() after checkForWin() and Field::isFailing() would give */
+struct BatchResult
+{
+  bool won;
+  bool failing;
+  /* goals on the field receiving the beams they want */
+  u32 satisfied;
+};
+
+/* traces many boards of the same size at once, each board of a batch is a bit of 64 bit lane masks. Boards are compared
+   to the first one of their batch and a tile keeps a variant for each different piece found on it, so the beams shared
+   by the boards are traced once for all of them and only split where a tile differs. Boards with a piece missing from
+   TransitionTable are traced one by one by a Field. */
+class BatchTracer
+{
+public:
+  static constexpr u32 LANES = 64;
+
+private:
+  /* a piece found on a tile by the boards of lanes, variants of a tile are chained through next */
+  struct Variant
+  {
+    u64 lanes;
+    u16 row;
+    PieceType type;
+    Direction rotation;
+    LaserColor color;
+    u32 next;
+  };
+
+  struct Beam
+  {
+    s32 x, y;
+    Direction direction;
+    LaserColor color;
+    u64 lanes;
+  };
+
+  static constexpr u32 NO_VARIANT = ~0U;
+
+  u32 width, height;
+  std::vector<Variant> variants;
+  /* first variant of each field tile, its lanes are the boards with the piece of the first board */
+  std::vector<u32> heads;
+
+  /* lanes which already traced each (tile, direction, color), entries listed in touched are cleared by the next batch */
+  std::vector<u64> visited;
+  std::vector<u32> touched;
+  std::vector<Beam> beams;
+
+  /* lanes of the beams which entered each goal tile by direction and by color channel */
+  std::vector<std::array<u64, 11>> hits;
+  std::vector<u32> goalTiles;
+  u64 failing;
+  /* boards with a goal left in the inventory, which can't be won */
+  u64 stranded;
+
+  Field fallback;
+
+  bool prepare(const FieldState* states, u32 count);
+  void trace();
+  void push(s32 x, s32 y, Direction direction, LaserColor color, u64 lanes);
+  void enter(const Beam& beam, const Variant& variant, u64 lanes);
+  void collect(u32 count, BatchResult* results) const;
+
+public:
+  BatchTracer(u32 width, u32 height, u32 invWidth, u32 invHeight);
+
+  /* states are snapshots of fields of the size of the tracer, they're traced by batches of LANES boards */
+  void evaluate(const FieldState* states, size_t count, BatchResult* results);
+  void evaluate(const std::vector<FieldState>& states, std::vector<BatchResult>& results);
+};
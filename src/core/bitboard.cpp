@@ -0,0 +1,214 @@
+#include "bitboard.h"
+
+#include "transitions.h"
+
+#include <algorithm>
+
+/* bit offset of one step in each direction, in the order of Position::directions */
+static constexpr s32 STEPS[8] = { -16, -15, 1, 17, 16, 15, -1, -17 };
+
+/* tiles reached from the given ones by repeated steps which only land on through tiles, in log2(SIDE) rounds */
+template<s32 STEP> static Bitboard fill(Bitboard tiles, Bitboard through)
+{
+  tiles |= through & tiles.shifted<STEP>();
+  through &= through.shifted<STEP>();
+  tiles |= through & tiles.shifted<2*STEP>();
+  through &= through.shifted<2*STEP>();
+  tiles |= through & tiles.shifted<4*STEP>();
+  through &= through.shifted<4*STEP>();
+  tiles |= through & tiles.shifted<8*STEP>();
+  return tiles;
+}
+
+/* runs of empty tiles crossed from the starting ones, ends are the tiles entered right after each run */
+template<u32 DIRECTION> static Bitboard cross(const Bitboard& start, const Bitboard& empty, const Bitboard& landing, Bitboard& ends)
+{
+  const Bitboard run = fill<STEPS[DIRECTION]>(start, empty & landing);
+  ends = run.shifted<STEPS[DIRECTION]>() & landing;
+  return run;
+}
+
+using cross_function = Bitboard (*)(const Bitboard&, const Bitboard&, const Bitboard&, Bitboard&);
+static const cross_function crossers[8] = { cross<0>, cross<1>, cross<2>, cross<3>, cross<4>, cross<5>, cross<6>, cross<7> };
+
+BitboardTracer::BitboardTracer() : width(0), height(0), pending(0), used(0), failing(false), entries(0)
+{
+  frontier.fill(Bitboard::none());
+  visited.fill(Bitboard::none());
+}
+
+void BitboardTracer::resize(u32 width, u32 height)
+{
+  this->width = width;
+  this->height = height;
+
+  Bitboard first = Bitboard::none(), last = Bitboard::none();
+  inside = Bitboard::none();
+
+  for (u32 y = 0; y < Bitboard::SIDE; ++y)
+  {
+    first.set(Bitboard::bit(0, y));
+    last.set(Bitboard::bit(Bitboard::SIDE - 1, y));
+
+    for (u32 x = 0; x < Bitboard::SIDE; ++x)
+      if (x < width && y < height)
+        inside.set(Bitboard::bit(x, y));
+  }
+
+  // a step east from the last column wraps to the first one of the next row and vice versa
+  for (u32 d = 0; d < 8; ++d)
+  {
+    const s32 dx = Position::directions[d][0];
+    landing[d] = inside & ~(dx > 0 ? first : (dx < 0 ? last : Bitboard::none()));
+  }
+}
+
+void BitboardTracer::enter(s32 x, s32 y, Direction direction, LaserColor color)
+{
+  if (x < 0 || x >= s32(width) || y < 0 || y >= s32(height))
+    return;
+
+  const u32 slot = direction*8 + color;
+  frontier[slot].set(Bitboard::bit(x, y));
+  pending |= u64(1) << slot;
+}
+
+void BitboardTracer::crossRuns(Direction direction, LaserColor color, Bitboard& entered)
+{
+  const Bitboard start = entered & empty;
+
+  if (!start.any())
+    return;
+
+  Bitboard ends;
+  const Bitboard run = crossers[direction](start, empty, landing[direction], ends);
+
+  for (u32 channel = 0; channel < 3; ++channel)
+    if (color & (1 << channel))
+      runs[(direction % 4)*3 + channel] |= run;
+
+  entered = (entered | ends) & occupied;
+}
+
+void BitboardTracer::enterPiece(const Board& board, u32 bit, Direction direction, LaserColor color)
+{
+  const s32 x = bit % Bitboard::SIDE, y = bit / Bitboard::SIDE;
+  const Transition& transition = TransitionTable::instance().at(board.rows[y*width + x], direction, color);
+
+  ++entries;
+
+  if (transition.blocked())
+    return;
+
+  if (!marked.test(bit))
+  {
+    marked.set(bit);
+    halves[bit] = 0;
+  }
+
+  u32& lasers = halves[bit];
+  lasers |= Board::laser((direction+4)%8, color);
+
+  if (transition.flags & Transition::GOAL)
+    goalHits.push_back(Laser(Position(x, y), direction, color));
+  if (transition.flags & Transition::FAIL)
+    failing = true;
+
+  for (u8 i = 0; i < transition.count; ++i)
+  {
+    const Direction beam = Transition::direction(transition.beams[i]);
+    const s32 bx = x + Position::directions[beam][0], by = y + Position::directions[beam][1];
+
+    if (bx >= 0 && bx < s32(width) && by >= 0 && by < s32(height))
+    {
+      enter(bx, by, beam, Transition::color(transition.beams[i]));
+      lasers |= Board::laser(beam, Transition::color(transition.beams[i]));
+    }
+  }
+
+  if (transition.continues())
+  {
+    const Direction next = Transition::direction(transition.next);
+    lasers |= Board::laser(next, Transition::color(transition.next));
+    enter(x + Position::directions[next][0], y + Position::directions[next][1], next, Transition::color(transition.next));
+  }
+}
+
+bool BitboardTracer::trace(Board& board)
+{
+  if (board.width != width || board.height != height)
+    resize(board.width, board.height);
+
+  occupied = Bitboard::none();
+
+  for (u32 y = 0; y < height; ++y)
+    for (u32 x = 0; x < width; ++x)
+    {
+      const u16 row = board.rows[y*width + x];
+
+      if (row == TransitionTable::NO_ROW)
+        return false;
+      else if (row != Board::EMPTY_ROW)
+        occupied.set(Bitboard::bit(x, y));
+    }
+
+  empty = inside & ~occupied;
+  marked = Bitboard::none();
+  runs.fill(Bitboard::none());
+  goalHits.clear();
+  failing = false;
+  entries = 0;
+
+  for (; used; used &= used - 1)
+    visited[Bitboard::lowest(used)] = Bitboard::none();
+
+  occupied.forEach([this, &board] (u32 bit) {
+    const u32 x = bit % Bitboard::SIDE, y = bit / Bitboard::SIDE, index = y*width + x;
+
+    if (board.types[index] == PIECE_SOURCE && board.colors[index] != LaserColor::NONE)
+    {
+      const Direction direction = static_cast<Direction>(board.rotations[index]);
+      enter(x + Position::directions[direction][0], y + Position::directions[direction][1], direction, board.colors[index]);
+    }
+  });
+
+  // beams entering the same kind of tile along the same (direction, color) are advanced together
+  while (pending)
+  {
+    const u32 slot = Bitboard::lowest(pending);
+    const Direction direction = static_cast<Direction>(slot / 8);
+    const LaserColor color = static_cast<LaserColor>(slot % 8);
+
+    Bitboard entered = frontier[slot];
+    frontier[slot] = Bitboard::none();
+    pending &= ~(u64(1) << slot);
+
+    crossRuns(direction, color, entered);
+
+    entered &= ~visited[slot];
+    visited[slot] |= entered;
+    used |= u64(1) << slot;
+
+    entered.forEach([this, &board, direction, color] (u32 bit) { enterPiece(board, bit, direction, color); });
+  }
+
+  std::fill(board.lasers.begin(), board.lasers.end(), 0);
+
+  Bitboard lit = marked;
+  for (const Bitboard& run : runs)
+    lit |= run;
+
+  lit.forEach([this, &board] (u32 bit) {
+    u32 lasers = marked.test(bit) ? halves[bit] : 0;
+
+    for (u32 axis = 0; axis < 4; ++axis)
+    {
+      const LaserColor color = static_cast<LaserColor>(runs[axis*3].test(bit) | runs[axis*3 + 1].test(bit) << 1 | runs[axis*3 + 2].test(bit) << 2);
+      lasers |= Board::laser(axis, color) | Board::laser(axis + 4, color);
+    }
+
+    board.lasers[(bit / Bitboard::SIDE)*width + bit % Bitboard::SIDE] = lasers;
+  });
+
+  return true;
+}
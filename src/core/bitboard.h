@@ -0,0 +1,128 @@
+#pragma once
+
+#include "board.h"
+#include "pieces.h"
+
+#include <array>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/* set of the tiles of a field up to 16x16, tile (x, y) is bit y*16 + x whatever the width of the field */
+struct Bitboard
+{
+  static constexpr u32 SIDE = 16;
+
+  u64 words[4];
+
+  static Bitboard none() { return { { 0, 0, 0, 0 } }; }
+  static u32 bit(u32 x, u32 y) { return y*SIDE + x; }
+
+  void set(u32 bit) { words[bit >> 6] |= u64(1) << (bit & 63); }
+  void reset(u32 bit) { words[bit >> 6] &= ~(u64(1) << (bit & 63)); }
+  bool test(u32 bit) const { return (words[bit >> 6] >> (bit & 63)) & 1; }
+  bool any() const { return (words[0] | words[1] | words[2] | words[3]) != 0; }
+
+  Bitboard operator&(const Bitboard& o) const { return { { words[0] & o.words[0], words[1] & o.words[1], words[2] & o.words[2], words[3] & o.words[3] } }; }
+  Bitboard operator|(const Bitboard& o) const { return { { words[0] | o.words[0], words[1] | o.words[1], words[2] | o.words[2], words[3] | o.words[3] } }; }
+  Bitboard operator~() const { return { { ~words[0], ~words[1], ~words[2], ~words[3] } }; }
+  Bitboard& operator&=(const Bitboard& o) { return *this = *this & o; }
+  Bitboard& operator|=(const Bitboard& o) { return *this = *this | o; }
+
+  /* moves every tile by STEP bits, tiles moved past either end of the 256 bits are dropped */
+  template<s32 STEP> Bitboard shifted() const
+  {
+    constexpr u32 amount = STEP < 0 ? -STEP : STEP, skip = amount / 64, bits = amount % 64;
+    Bitboard result = none();
+
+    for (u32 i = 0; i + skip < 4; ++i)
+    {
+      if constexpr (STEP > 0)
+      {
+        u64 word = words[i] << bits;
+        if constexpr (bits != 0)
+          word |= i > 0 ? words[i - 1] >> (64 - bits) : 0;
+        result.words[i + skip] = word;
+      }
+      else
+      {
+        u64 word = words[i + skip] >> bits;
+        if constexpr (bits != 0)
+          word |= i + skip < 3 ? words[i + skip + 1] << (64 - bits) : 0;
+        result.words[i] = word;
+      }
+    }
+
+    return result;
+  }
+
+  static u32 lowest(u64 word)
+  {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return index;
+#else
+    return __builtin_ctzll(word);
+#endif
+  }
+
+  template<typename F> void forEach(F f) const
+  {
+    for (u32 i = 0; i < 4; ++i)
+      for (u64 word = words[i]; word; word &= word - 1)
+        f(i*64 + lowest(word));
+  }
+};
+
+/* propagates the beams of every source of a board at once, beams cross empty tiles as whole runs shifted through
+   the 256 bit masks and TransitionTable is only looked up where a beam enters a piece. Beams are kept per
+   (direction, color) and each of them enters a piece at most once, which gives the lasers, goal hits and TNT
+   hits of tracing the sources one by one as Field::updateLasers() does. */
+class BitboardTracer
+{
+private:
+  u32 width, height;
+  Bitboard inside;
+  /* tiles a beam moving in each direction can land on, inside the field and not wrapped around a row */
+  std::array<Bitboard, 8> landing;
+
+  Bitboard occupied, empty;
+  /* beams about to enter tiles, by direction*8 + color, pending has a bit for each non empty mask */
+  std::array<Bitboard, 64> frontier;
+  u64 pending;
+  /* pieces already entered by a beam, by direction*8 + color, used has a bit for each mask to clear */
+  std::array<Bitboard, 64> visited;
+  u64 used;
+
+  /* empty tiles crossed along each axis by each color channel, by (direction % 4)*3 + channel */
+  std::array<Bitboard, 12> runs;
+  /* half segments lit on the pieces, only tiles in marked are meaningful */
+  std::array<u32, Bitboard::SIDE * Bitboard::SIDE> halves;
+  Bitboard marked;
+
+  std::vector<Laser> goalHits;
+  bool failing;
+  u32 entries;
+
+  void resize(u32 width, u32 height);
+  void enter(s32 x, s32 y, Direction direction, LaserColor color);
+  void crossRuns(Direction direction, LaserColor color, Bitboard& entered);
+  void enterPiece(const Board& board, u32 bit, Direction direction, LaserColor color);
+
+public:
+  BitboardTracer();
+
+  static bool fits(u32 width, u32 height) { return width <= Bitboard::SIDE && height <= Bitboard::SIDE; }
+
+  /* fills board.lasers, fails without touching it when a piece on the board isn't in TransitionTable */
+  bool trace(Board& board);
+
+  /* beams which entered a goal, positions are field coordinates */
+  const std::vector<Laser>& goals() const { return goalHits; }
+  bool isFailing() const { return failing; }
+  /* beams which entered a piece during last trace */
+  u32 pieceEntries() const { return entries; }
+};
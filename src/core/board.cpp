@@ -0,0 +1,29 @@
+#include "board.h"
+
+void Board::updateJumps(u32 index)
+{
+  const u32 x = index % width, y = index / width;
+
+  for (u32 d = 0; d < 8; ++d)
+  {
+    const s32 dx = Position::directions[d][0], dy = Position::directions[d][1];
+    const u32 behind = edgeDistance(x, y, (d + 4) % 8);
+    const bool next = edgeDistance(x, y, d) > 1;
+    u32 run = empty(index) ? 1 + (next ? jumps[(index + stride(d)) * 8 + d] : 0) : 0;
+
+    jumps[index * 8 + d] = static_cast<u8>(run);
+
+    s32 tx = x, ty = y;
+    for (u32 i = 1; i < behind; ++i)
+    {
+      tx -= dx;
+      ty -= dy;
+      const u32 tile = ty * width + tx;
+
+      if (!empty(tile))
+        break;
+
+      jumps[tile * 8 + d] = static_cast<u8>(++run);
+    }
+  }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "common/common.h"
+
+#include <algorithm>
+#include <vector>
+
+/* flat copy of the field tiles read by the simulation core and by the renderer,
+   each array is indexed by y*width + x so the whole board is a few cache lines per attribute */
+struct Board
+{
+  enum Flags : u8
+  {
+    MOVABLE   = 0x01,
+    ROTATABLE = 0x02,
+    COLORABLE = 0x04,
+    INFINITE  = 0x08,
+    SATISFIED = 0x10
+  };
+
+  static constexpr PieceType EMPTY = PIECES_COUNT;
+  static constexpr u16 EMPTY_ROW = 0xFFFE;
+
+  u32 width = 0, height = 0;
+
+  std::vector<PieceType> types;
+  std::vector<u8> rotations;
+  std::vector<LaserColor> colors;
+  std::vector<u8> flags;
+  /* TransitionTable row of the piece, EMPTY_ROW for empty tiles */
+  std::vector<u16> rows;
+  /* laser color of each of the 8 half segments of a tile, 3 bits per direction */
+  std::vector<u32> lasers;
+  /* for each tile and direction at index*8 + direction, how many empty tiles a beam crosses from the tile
+     before reaching a piece or the edge, 0 on occupied tiles */
+  std::vector<u8> jumps;
+
+  void resize(u32 width, u32 height)
+  {
+    const size_t size = width * height;
+    this->width = width;
+    this->height = height;
+
+    types.resize(size);
+    rotations.resize(size);
+    colors.resize(size);
+    flags.resize(size);
+    rows.resize(size);
+    lasers.resize(size);
+    jumps.resize(size * 8);
+    clear();
+  }
+
+  void clear()
+  {
+    std::fill(types.begin(), types.end(), EMPTY);
+    std::fill(rotations.begin(), rotations.end(), 0);
+    std::fill(colors.begin(), colors.end(), LaserColor::NONE);
+    std::fill(flags.begin(), flags.end(), 0);
+    std::fill(rows.begin(), rows.end(), EMPTY_ROW);
+    std::fill(lasers.begin(), lasers.end(), 0);
+
+    for (u32 y = 0; y < height; ++y)
+      for (u32 x = 0; x < width; ++x)
+        for (u32 d = 0; d < 8; ++d)
+          jumps[(y * width + x) * 8 + d] = static_cast<u8>(edgeDistance(x, y, d));
+  }
+
+  /* tiles from (x, y) included to the edge in the direction */
+  u32 edgeDistance(u32 x, u32 y, u32 direction) const
+  {
+    const s32 dx = Position::directions[direction][0], dy = Position::directions[direction][1];
+    const u32 horizontal = dx > 0 ? width - x : (dx < 0 ? x + 1 : ~0U);
+    const u32 vertical = dy > 0 ? height - y : (dy < 0 ? y + 1 : ~0U);
+    return std::min(horizontal, vertical);
+  }
+
+  s32 stride(u32 direction) const { return Position::directions[direction][1] * s32(width) + Position::directions[direction][0]; }
+
+  /* the tile at index became empty or occupied, runs ending on it are recomputed backwards from it */
+  void updateJumps(u32 index);
+
+  size_t size() const { return types.size(); }
+  bool empty(size_t index) const { return types[index] == EMPTY; }
+
+  static u32 laser(u32 direction, LaserColor color) { return static_cast<u32>(color) << (direction * 3); }
+  static LaserColor laserColor(u32 lasers, u32 direction) { return static_cast<LaserColor>((lasers >> (direction * 3)) & 0x07); }
+};
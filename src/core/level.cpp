@@ -12,7 +12,7 @@
 
 using namespace std;
 
-Piece* Field::generatePiece(const PieceInfo& info)
+Piece Field::generatePiece(const PieceInfo& info) const
 {
   switch (info.type)
   {
@@ -51,34 +51,25 @@ Piece* Field::generatePiece(const PieceInfo& info)
 
     case PIECE_TNT:
 
-      return new Piece(info.type, info.direction, info.color);
+      return Piece(info.type, info.direction, info.color);
 
-    //case PIECE_ROUND_FILTER: return new RoundFilter(); //TODO: why empty constructor?
+    //case PIECE_ROUND_FILTER: return Piece(PIECE_ROUND_FILTER); //TODO: why empty constructor?
 
-    case PIECE_STRICT_GOAL:
-    {
-      Goal* goal = new StrictGoal(info.color);
-      goals.push_back(goal); /* weak reference to goal since it's already as unique_ptr in tile */
-      return goal;
-    }
-
-  
+    case PIECE_STRICT_GOAL: return Piece(PIECE_STRICT_GOAL, info.color);
       
-    case PIECE_MINE: return new Mine();
-    case PIECE_SLIME: return new Slime();
+    case PIECE_MINE: return Piece(PIECE_MINE);
+    case PIECE_SLIME: return Piece(PIECE_SLIME);
     // TODO: finire
     default:
       assert(false);
-      return nullptr;
+      return Piece();
   }
   
-  return nullptr;
+  return Piece();
 }
 
-void Field::load(const LevelSpec* level)
+void Field::load(const LevelRef& level)
 {
-  printf("Loading %s\n", level->name.c_str());
-  
   this->_level = level;
   
   u32 curInvSlot = 0;
@@ -87,29 +78,73 @@ void Field::load(const LevelSpec* level)
   {
     const PieceInfo& info = level->at(i);
     
-    Piece* piece = generatePiece(info);
+    Piece piece = generatePiece(info);
     
-    if (piece)
+    if (!piece.empty())
     {
       //if (info->spec->canBeRotated)
-      piece->setCanBeRotated(info.roteable);
-      piece->setCanBeMoved(info.moveable);
+      piece.setCanBeRotated(info.roteable);
+      piece.setCanBeMoved(info.moveable);
+      
+      const Position position = info.inventory ? Position(Position::Type::INVENTORY, curInvSlot%_invWidth, curInvSlot/_invWidth) : Position(info.x, info.y);
+      
+      // levels made for a larger field or inventory lose the pieces which don't fit
+      if (info.inventory ? isInsideInventory(position) : isInside(position))
+        place(position, piece);
       
       if (info.inventory)
-      {
-        place(Position(Position::Type::INVENTORY, curInvSlot%_invWidth, curInvSlot/_invWidth), piece);
         ++curInvSlot;
-      }
-      else
-        place(Position(info.x, info.y), piece);
     }
     else
     {
-      printf("Missing allocation: %c (%s)\n", info.type, level->name.c_str());
+      printf("Missing allocation: %c (%.*s)\n", info.type, static_cast<int>(level->name().length()), level->name().data());
     }
   }
   
   updateLasers();
+  // updates leave the board in sync with the tiles
+  if (staticScene)
+    scene.build(_board);
+}
+
+void Field::snapshot(FieldState& state) const
+{
+  state.pieces.resize(tiles.size() + inventory.size());
+
+  for (size_t i = 0; i < tiles.size(); ++i)
+    state.pieces[i] = tiles[i].piece() ? *tiles[i].piece() : Piece();
+  for (size_t i = 0; i < inventory.size(); ++i)
+    state.pieces[tiles.size() + i] = inventory[i].piece() ? *inventory[i].piece() : Piece();
+
+  // sharing the level only when it differs keeps snapshots of the same level free of reference counting
+  if (state.level.get() != _level.get())
+    state.level = _level;
+  state.failed = failed;
+}
+
+void Field::restore(const FieldState& state)
+{
+  assert(state.pieces.size() == tiles.size() + inventory.size());
+
+  for (size_t i = 0; i < state.pieces.size(); ++i)
+  {
+    Tile& tile = i < tiles.size() ? tiles[i] : inventory[i - tiles.size()];
+    const Piece& piece = state.pieces[i];
+
+    if ((tile.piece() ? *tile.piece() : Piece()) != piece)
+    {
+      tile.clear();
+      tile.place(piece);
+      invalidate(positionOf(&tile));
+    }
+  }
+
+  if (_level.get() != state.level.get())
+    _level = state.level;
+  updateLasers();
+  // failing is recomputed but failed is sticky, it's whatever it was when the snapshot was taken
+  failed = state.failed;
+  checkForWin();
 }
 
 void Field::generateBeam(Position position, Direction direction, LaserColor color)
@@ -120,77 +155,441 @@ void Field::generateBeam(Position position, Direction direction, LaserColor colo
   {
     lasers.push_back(beam);
     
-    Tile *tile = tileAt(position);
+    const u32 index = position.y*_width + position.x;
     
-    if (!tile->piece() || tile->piece()->type() != PIECE_SOURCE)
-      tileAt(position)->colors[direction] |= color;
+    // the tile emitting the beam is part of the trace even if no other beam crosses it
+    trace->touched[index] = true;
+    if (_board.types[index] != PIECE_SOURCE)
+      trace->lasers[index] |= Board::laser(direction, color);
   }
 }
 
-void Field::updateLasers()
+void Field::syncTile(u32 index)
 {
-  beams.clear();
+  const Piece* piece = tiles[index].piece();
+  const bool wasGoal = _board.types[index] == PIECE_STRICT_GOAL || _board.types[index] == PIECE_LOOSE_GOAL;
+  const bool wasEmpty = _board.empty(index);
+  const u16 wasRow = _board.rows[index];
+  
+  if (wasGoal && !(piece && piece->isGoal()))
+    goals.erase(std::find_if(goals.begin(), goals.end(), [index](const GoalState& goal) { return goal.index == index; }));
+  else if (!wasGoal && piece && piece->isGoal())
+    goals.push_back({ index, 0, LaserColor::NONE, false });
+  
+  if (piece)
+  {
+    _board.types[index] = piece->type();
+    _board.rotations[index] = piece->rotation();
+    _board.colors[index] = piece->color();
+    _board.flags[index] = (piece->canBeMoved() ? Board::MOVABLE : 0) | (piece->canBeRotated() ? Board::ROTATABLE : 0) |
+      (piece->canBeColored() ? Board::COLORABLE : 0) | (piece->isInfinite() ? Board::INFINITE : 0);
+    _board.rows[index] = TransitionTable::instance().row(piece->type(), piece->rotation(), piece->color());
+  }
+  else
+  {
+    _board.types[index] = Board::EMPTY;
+    _board.rotations[index] = 0;
+    _board.colors[index] = LaserColor::NONE;
+    _board.flags[index] = 0;
+    _board.rows[index] = Board::EMPTY_ROW;
+  }
+  
+  if (_board.rows[index] != wasRow)
+    scene.update(index, _board.rows[index]);
+  
+  if (wasEmpty != !piece)
+    _board.updateJumps(index);
+}
 
-  std::for_each(goals.begin(), goals.end(), [](auto& g) { g->reset(); });
+void Field::addTrace(u32 origin)
+{
+  if (spareTraces.empty())
+    traces.emplace_back(origin, tiles.size());
+  else
+  {
+    traces.push_back(std::move(spareTraces.back()));
+    spareTraces.pop_back();
+    traces.back().origin = origin;
+    traces.back().dirty = true;
+  }
+}
 
-  for (int i = 0; i < _width; ++i)
-    for (int j = 0; j < _height; ++j)
-    {
-      Tile *tile = tileAt(Position(i, j));
-      tile->resetLasers();
-      const auto& piece = tile->piece();
-      
-      if (piece)
-      {
-        Laser laser = piece->produceLaser();
-        
-        if (laser.color != LaserColor::NONE)
-          generateBeam(laser.position + Position(i, j), laser.direction, laser.color);
+void Field::recycleTrace(size_t index)
+{
+  spareTraces.push_back(std::move(traces[index]));
+  
+  if (index != traces.size() - 1)
+    traces[index] = std::move(traces.back());
+  
+  traces.pop_back();
+}
 
-      }
-    }
+void Field::traceSource(BeamTrace& sourceTrace)
+{
+  if (!traceSource(sourceTrace, packedChannels))
+    traceSource(sourceTrace, false);
+}
+
+/* false when tracing with packed channels reached a piece which mixes them, what was traced must then be thrown away */
+bool Field::traceSource(BeamTrace& sourceTrace, bool packed)
+{
+  sourceTrace.clear();
+  sourceTrace.touched[sourceTrace.origin] = true;
+  
+  const Tile& source = tiles[sourceTrace.origin];
+  
+  if (!source.piece())
+    return true;
+  
+  Laser laser = source.piece()->produceLaser();
+  
+  if (laser.color == LaserColor::NONE)
+    return true;
+  
+  const TransitionTable& table = TransitionTable::instance();
+  
+  sourceTrace.emitting = true;
+  trace = &sourceTrace;
+  if (packed)
+    std::fill(channels.begin(), channels.end(), 0);
+  else
+    std::fill(visited.begin(), visited.end(), 0);
+  
+  generateBeam(laser.position + Position(source.x, source.y), laser.direction, laser.color);
   
-  list<Laser>::iterator it = lasers.begin();
   while (!lasers.empty())
   {
-    Laser& laser = (*it);
+    Laser beam = lasers.back();
+    lasers.pop_back();
+    ++beams;
 
-    while (isInside(laser.position))
+    while (isInside(beam.position))
     {
-      if (beams.find(laser) != beams.end())
-        break;
+      const u32 index = beam.position.y*_width + beam.position.x;
       
-      beams.insert(laser);
+      // each (tile, direction, color) or each channel with packed channels is traced at most once so mirror loops terminate
+      if (packed ? !markChannels(index, beam) : markVisited(index, beam))
+        break;
 
-      Tile *tile = tileAt(laser.position);
+      // beams crossing only fixed tiles replay what they did when first traced
+      if (const StaticScene::Segment* segment = scene.follow(index, beam.direction, beam.color))
+      {
+        if (packed && segment->mixing)
+        {
+          lasers.clear();
+          trace = nullptr;
+          return false;
+        }
+        
+        for (u32 i = segment->firstHalf; i < segment->lastHalf; ++i)
+        {
+          const StaticScene::Half& half = scene.half(i);
+          sourceTrace.touched[half.index] = true;
+          sourceTrace.lasers[half.index] |= half.lasers;
+        }
+        
+        for (u32 i = segment->firstHit; i < segment->lastHit; ++i)
+          sourceTrace.goalHits.push_back(scene.hit(i));
+        for (u32 i = segment->firstExit; i < segment->lastExit; ++i)
+          lasers.push_back(scene.exit(i));
+        
+        sourceTrace.failed |= segment->failed;
+        break;
+      }
+      
+      u32& tileLasers = sourceTrace.lasers[index];
+      const u16 row = _board.rows[index];
       
-      const auto& piece = tile->piece();
+      sourceTrace.touched[index] = true;
       
-      if (piece && piece->blocksLaser(laser))
+      if (row == Board::EMPTY_ROW)
+      {
+        // the whole run of empty tiles up to the next piece or the edge is crossed at once and only the visited bit
+        // of the tile the beam entered it from is set, a beam entering the same run from another tile, like the exit
+        // of a teleporter, crosses the rest of the run again but never loops since each entry is marked
+        const u32 run = _board.jumps[index*8 + beam.direction];
+        const s32 stride = _board.stride(beam.direction);
+        const u32 halves = Board::laser((beam.direction+4)%8, beam.color) | Board::laser(beam.direction, beam.color);
+        
+        for (u32 i = 0, tile = index; i < run; ++i, tile += stride)
+        {
+          sourceTrace.touched[tile] = true;
+          sourceTrace.lasers[tile] |= halves;
+        }
+        
+        beam.position.x += Position::directions[beam.direction][0] * run;
+        beam.position.y += Position::directions[beam.direction][1] * run;
+        continue;
+      }
+      else if (row != TransitionTable::NO_ROW)
+      {
+        // the channels of the beam may have been dropped on the way, what such a piece does with them depends on all of them
+        if (packed && table.mixes(row))
+        {
+          lasers.clear();
+          trace = nullptr;
+          return false;
+        }
+        
+        const Transition& transition = table.at(row, beam.direction, beam.color);
+        
+        if (transition.blocked())
+          break;
+        
+        tileLasers |= Board::laser((beam.direction+4)%8, beam.color);
+        
+        // goals are replayed when traces are merged since they collect beams from every source
+        if (transition.flags & Transition::GOAL)
+          sourceTrace.goalHits.push_back(beam);
+        if (transition.flags & Transition::FAIL)
+          sourceTrace.failed = true;
+        
+        for (u8 i = 0; i < transition.count; ++i)
+        {
+          const Direction direction = Transition::direction(transition.beams[i]);
+          const Laser branch = Laser(beam.position + direction, direction, Transition::color(transition.beams[i]));
+          
+          if (isInside(branch.position))
+          {
+            lasers.push_back(branch);
+            tileLasers |= Board::laser(direction, branch.color);
+          }
+        }
+        
+        if (!transition.continues())
+          break;
+        
+        beam.direction = Transition::direction(transition.next);
+        beam.color = Transition::color(transition.next);
+        tileLasers |= Board::laser(beam.direction, beam.color);
+        beam.advance();
+        continue;
+      }
+      
+      const auto& piece = tiles[index].piece();
+      
+      if (piece && piece->blocksLaser(beam))
         break;
            
       // place first half of laser if piece doesn't block it
-      tile->colors[(laser.direction+4)%8] |= laser.color;
+      tileLasers |= Board::laser((beam.direction+4)%8, beam.color);
 
       // update existing laser or add new lasers according to piece behavior
       if (piece)
-        piece->receiveLaser(this, laser);
+        piece->receiveLaser(this, beam);
       
       // keep drawing the other laser if receiveLaser didn't invalidate it
-      if (isInside(laser.position))
+      if (isInside(beam.position))
       {
-        tile->colors[laser.direction] |= laser.color;
-        laser.advance();
+        tileLasers |= Board::laser(beam.direction, beam.color);
+        beam.advance();
       }
     }
+  }
+  
+  trace = nullptr;
+  return true;
+}
+
+void Field::mergeTraces()
+{
+  for (size_t i = 0; i < tiles.size(); ++i)
+  {
+    if (!affected[i])
+      continue;
+    
+    u32 lasers = 0;
+    
+    for (const BeamTrace& trace : traces)
+      if (trace.touched[i])
+        lasers |= trace.lasers[i];
+    
+    _board.lasers[i] = lasers;
+  }
+  
+  clearGoals();
+  failing = false;
+  
+  for (const BeamTrace& trace : traces)
+  {
+    for (const Laser& hit : trace.goalHits)
+      hitGoal(hit);
     
-    it = lasers.erase(it);
+    failing |= trace.failed;
   }
+  
+  settleGoals();
+}
+
+bool Field::traceBitboard()
+{
+  if (boardValid)
+  {
+    for (u32 index : changed)
+      syncTile(index);
+  }
+  else
+  {
+    for (u32 i = 0; i < tiles.size(); ++i)
+      syncTile(i);
+  }
+  
+  changed.clear();
+  boardValid = true;
+  // the per source traces aren't kept up to date
+  tracesValid = false;
+  
+  if (!tracer.trace(_board))
+    return false;
+  
+  beams = tracer.pieceEntries();
+  
+  clearGoals();
+  
+  for (const Laser& hit : tracer.goals())
+    hitGoal(hit);
+  
+  failing = tracer.isFailing();
+  settleGoals();
+  return true;
+}
+
+void Field::clearGoals()
+{
+  for (GoalState& goal : goals)
+  {
+    goal.directions = 0;
+    goal.colors = LaserColor::NONE;
+  }
+}
+
+void Field::settleGoals()
+{
+  failed |= failing;
+  
+  for (GoalState& goal : goals)
+  {
+    const LaserColor color = _board.colors[goal.index];
+    
+    u8 foundDirections = 0;
+    for (int i = 0; i < 4; ++i)
+      if ((goal.directions & 1<<(4+i)) || (goal.directions & 1<<(i)))
+        ++foundDirections;
+    
+    if (color == LaserColor::NONE)
+      goal.satisfied = goal.colors == LaserColor::NONE && foundDirections == 0;
+    else
+      goal.satisfied = goal.colors == color && foundDirections == 1;
+    
+    if (goal.satisfied)
+      _board.flags[goal.index] |= Board::SATISFIED;
+    else
+      _board.flags[goal.index] &= ~Board::SATISFIED;
+  }
+}
+
+void Field::hitGoal(const Laser& laser)
+{
+  const u32 index = laser.position.y*_width + laser.position.x;
+  
+  for (GoalState& goal : goals)
+  {
+    if (goal.index == index)
+    {
+      goal.colors = static_cast<LaserColor>(goal.colors | laser.color);
+      goal.directions |= 1 << laser.direction;
+      break;
+    }
+  }
+}
+
+void Field::updateLasers()
+{
+  beams = 0;
+  
+  if (bitboard && traceBitboard())
+    return;
+  
+  if (incremental && tracesValid)
+  {
+    std::fill(affected.begin(), affected.end(), false);
+    
+    for (u32 index : changed)
+      syncTile(index);
+    
+    for (u32 index : changed)
+    {
+      bool hasTrace = false;
+      
+      for (BeamTrace& trace : traces)
+      {
+        if (trace.touched[index])
+          trace.dirty = true;
+        hasTrace |= trace.origin == index;
+      }
+      
+      // the change could have dropped a new source on the tile
+      if (!hasTrace)
+        addTrace(index);
+    }
+    
+    changed.clear();
+    
+    for (BeamTrace& trace : traces)
+    {
+      if (!trace.dirty)
+        continue;
+      
+      for (size_t i = 0; i < tiles.size(); ++i)
+        if (trace.touched[i]) affected[i] = true;
+      
+      traceSource(trace);
+      trace.dirty = false;
+      
+      for (size_t i = 0; i < tiles.size(); ++i)
+        if (trace.touched[i]) affected[i] = true;
+    }
+    
+    for (size_t i = traces.size(); i > 0; --i)
+      if (!traces[i - 1].emitting)
+        recycleTrace(i - 1);
+    
+    mergeTraces();
+    return;
+  }
+  
+  while (!traces.empty())
+    recycleTrace(traces.size() - 1);
+  changed.clear();
+  
+  for (u32 i = 0; i < tiles.size(); ++i)
+    syncTile(i);
+
+  for (u32 i = 0; i < tiles.size(); ++i)
+  {
+    const auto& piece = tiles[i].piece();
+    
+    if (piece && piece->produceLaser().color != LaserColor::NONE)
+    {
+      addTrace(i);
+      traceSource(traces.back());
+      traces.back().dirty = false;
+    }
+  }
+  
+  std::fill(affected.begin(), affected.end(), true);
+  mergeTraces();
+  tracesValid = true;
 }
 
 void Field::checkForWin()
 {
-  won = std::all_of(goals.begin(), goals.end(), [](const auto& goal) { return goal->isSatisfied(); });
+  won = std::all_of(goals.begin(), goals.end(), [](const GoalState& goal) { return goal.satisfied; });
+  
+  // a goal still in the inventory can't receive any laser
+  won &= std::none_of(inventory.begin(), inventory.end(), [](const Tile& tile) {
+    return tile.piece() && tile.piece()->isGoal() && tile.piece()->color() != LaserColor::NONE;
+  });
 }
 
 void Field::generateDummy()
@@ -219,11 +618,11 @@ void Field::generateDummy()
     info.roteable = true;
     info.color = mechanics->canBeColored() ? LaserColor::RED : LaserColor::NONE;
     info.direction = Dir::NORTH;
-    Piece* piece = generatePiece(info);
+    Piece piece = generatePiece(info);
 
-    piece->setCanBeMoved(true);
-    piece->setCanBeColored(true);
-    piece->setInfinite(true);
+    piece.setCanBeMoved(true);
+    piece.setCanBeColored(true);
+    piece.setInfinite(true);
 
     place(base, piece);
 
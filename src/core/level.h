@@ -12,7 +12,7 @@
 #include <cstdlib>
 
 #include <list>
-#include <unordered_set>
+#include <vector>
 
 #include <sstream>
 #include <string>
@@ -22,7 +22,12 @@
 
 #include <cassert>
 
+#include "bitboard.h"
+#include "board.h"
 #include "pieces.h"
+#include "scene.h"
+#include "transitions.h"
+#include "zobrist.h"
 #include "files/files.h"
 
 class Game;
@@ -30,60 +35,175 @@ class Game;
 class Tile
 {
 private:
-  std::unique_ptr<Piece> _piece;
+  Piece _piece;
 public:
   u8 x, y;
 
 public:
-  std::array<LaserColor, 8> colors;
-  
   u8 variant;
   
-  Tile() : _piece{nullptr}, colors{LaserColor::NONE}, x{0}, y{0}, variant{static_cast<u8>(rand()%3)} { }
+  Tile() : _piece(), x{0}, y{0}, variant{static_cast<u8>(rand()%3)} { }
   
-  void resetLasers() { std::fill(colors.begin(), colors.end(), LaserColor::NONE); }
-  void clear() { _piece.reset(); }
+  void clear() { _piece = Piece(); }
 
-  bool empty() const { return _piece == nullptr; }
+  bool empty() const { return _piece.empty(); }
   
-  const std::unique_ptr<Piece>& piece() const { return _piece; }
+  const Piece* piece() const { return _piece.empty() ? nullptr : &_piece; }
+  Piece* piece() { return _piece.empty() ? nullptr : &_piece; }
 
-  void place(Piece* piece)
+  void place(const Piece& piece)
   {
-    if (piece)
-      assert(!_piece);
+    if (!piece.empty())
+      assert(_piece.empty());
 
-    _piece.reset(piece);
+    _piece = piece;
   }
 
-  void swap(std::unique_ptr<Piece>& other) { std::swap(_piece, other); }
+  void swap(Piece& other) { std::swap(_piece, other); }
   void swap(Tile* other) { std::swap(_piece, other->_piece); }
 };
 
+/* what a goal received during last update, the goal piece itself is stored by value in its tile */
+struct GoalState
+{
+  u32 index;
+  u8 directions;
+  LaserColor colors;
+  bool satisfied;
+};
+
+/* pieces of every tile of a Field, field tiles first and then inventory ones,
+   taking a new snapshot into the same state reuses its buffer */
+struct FieldState
+{
+  std::vector<Piece> pieces;
+  LevelRef level;
+  bool failed;
+
+  FieldState() : failed(false) { }
+};
+
+/* beams produced by a single source, kept so that edits only re-trace the sources they affect */
+struct BeamTrace
+{
+  u32 origin;
+  std::vector<bool> touched;
+  std::vector<u32> lasers;
+  std::vector<Laser> goalHits;
+  bool failed;
+  bool emitting;
+  bool dirty;
+
+  BeamTrace(u32 origin, size_t size) : origin(origin), touched(size, false), lasers(size, 0), failed(false), emitting(false), dirty(true) { }
+
+  void clear()
+  {
+    std::fill(touched.begin(), touched.end(), false);
+    std::fill(lasers.begin(), lasers.end(), 0);
+    goalHits.clear();
+    failed = false;
+    emitting = false;
+  }
+};
+
 class Field
 {  
 private:
   u32 _width, _height, _invWidth, _invHeight;
   
-  const LevelSpec* _level;
+  LevelRef _level;
   
   std::vector<Tile> tiles;
   std::vector<Tile> inventory;
-  std::list<Laser> lasers;
-  std::list<Goal*> goals;
-  std::unordered_set<Laser, Laser::hash> beams;
+  Board _board;
+  /* pending beams, capacity is kept between updates so that tracing doesn't allocate */
+  std::vector<Laser> lasers;
+  /* goals on the field by tile index, kept in sync with the board */
+  std::vector<GoalState> goals;
+  /* one bit per (direction, color) for each tile, tells which beams already entered it while tracing */
+  std::vector<u64> visited;
+  /* when tracing with packed channels, 4 bits per direction for each tile: the channels which already entered it
+     and a last bit for beams without color */
+  std::vector<u32> channels;
+
+  std::vector<BeamTrace> traces;
+  std::vector<BeamTrace> spareTraces;
+  std::vector<u32> changed;
+  std::vector<bool> affected;
+  BeamTrace* trace;
+  bool incremental;
+  bool tracesValid;
+  BitboardTracer tracer;
+  bool bitboard;
+  bool packedChannels;
+  /* fixed part of the loaded level, beams crossing it are replayed instead of traced */
+  StaticScene scene;
+  bool staticScene;
+  /* the board matches the tiles but for the changed ones */
+  bool boardValid;
+  /* beams popped from the worklist during last update, or pieces entered by a beam when tracing with the bitboard */
+  u32 beams;
   
   bool won;
   bool failed;
+  /* a beam hits a TNT in the current configuration, unlike failed it's cleared by later updates */
+  bool failing;
+
+  /* hash of the pieces on the field and in the inventory, inventory tiles follow field tiles in tileKeys */
+  Zobrist zobrist;
+  std::vector<u64> tileKeys;
+  u64 _hash;
+
+  bool markVisited(u32 index, const Laser& laser)
+  {
+    const u64 bit = u64(1) << (laser.direction*8 + laser.color);
+    const bool seen = (visited[index] & bit) != 0;
+    visited[index] |= bit;
+    return seen;
+  }
+
+  /* drops the channels of the beam which already entered the tile in its direction, false when none is left */
+  bool markChannels(u32 index, Laser& laser)
+  {
+    const u32 shift = laser.direction*4;
+    const u32 bits = laser.color == LaserColor::NONE ? 0x08 : laser.color;
+    const u32 fresh = bits & ~(channels[index] >> shift);
+    
+    if (!fresh)
+      return false;
+    
+    channels[index] |= fresh << shift;
+    laser.color = static_cast<LaserColor>(fresh & LaserColor::WHITE);
+    return true;
+  }
+
+  void syncTile(u32 index);
+  void addTrace(u32 origin);
+  void recycleTrace(size_t index);
+  void traceSource(BeamTrace& sourceTrace);
+  bool traceSource(BeamTrace& sourceTrace, bool packed);
+  void mergeTraces();
+  bool traceBitboard();
+  void clearGoals();
+  void hitGoal(const Laser& laser);
+  void settleGoals();
+  
+  friend class TransitionTable;
 
 public:
   Field(u32 width, u32 height, u32 invWidth, u32 invHeight) :
   _width(width), _height(height),
   _invWidth(invWidth), _invHeight(invHeight),
-  _level(nullptr),
-  failed(false), won(false)
+  trace(nullptr),
+  incremental(false), tracesValid(false), bitboard(false), packedChannels(false), scene(width, height), staticScene(false), boardValid(false), beams(0),
+  won(false), failed(false), failing(false),
+  zobrist(width*height + invWidth*invHeight), tileKeys(width*height + invWidth*invHeight, 0), _hash(0)
   {
     tiles.resize(width*height);
+    _board.resize(width, height);
+    visited.resize(width*height);
+    channels.resize(width*height);
+    affected.resize(width*height);
     inventory.resize(invWidth*invHeight);
     
     for (u32 i = 0; i < _width; ++i)
@@ -123,11 +243,13 @@ public:
     updateLasers();
   }
   
-  const LevelSpec* const level() { return _level; }
+  const LevelSpec* level() const { return _level.get(); }
   u32 width() const { return _width; }
   u32 height() const { return _height; }
   u32 invWidth() const { return _invWidth; }
   u32 invHeight() const { return _invHeight; }
+  const Board& board() const { return _board; }
+  const std::vector<GoalState>& goalStates() const { return goals; }
   
   bool isInside(const Pos& p) const { return p.x >= 0 && p.x < _width && p.y >= 0 && p.y < _height; }
   bool isInsideInventory(const Pos& p) const { return p.x >= 0 && p.x < _invWidth && p.y >= 0 && p.y < _invHeight; }
@@ -135,24 +257,79 @@ public:
   void reset()
   {
     goals.clear();
-    beams.clear();
+    while (!traces.empty())
+      recycleTrace(traces.size() - 1);
+    changed.clear();
+    scene.suspend();
+    tracesValid = false;
     failed = false;
+    failing = false;
+    
+    _hash = 0;
+    std::fill(tileKeys.begin(), tileKeys.end(), 0);
     
-    std::for_each(tiles.begin(), tiles.end(), [] (Tile& tile) { tile.resetLasers(); tile.clear(); });
+    _board.clear();
+    std::for_each(tiles.begin(), tiles.end(), [] (Tile& tile) { tile.clear(); });
     std::for_each(inventory.begin(), inventory.end(), [] (Tile& tile) { tile.clear(); });    
   }
 
-  Piece* generatePiece(const PieceInfo& info);
-  void load(const LevelSpec* level);
+  Piece generatePiece(const PieceInfo& info) const;
+  void load(const LevelRef& level);
 
-  void fail() { failed = true; }
+  void snapshot(FieldState& state) const;
+  /* only tiles which differ from the state are changed, so in incremental mode just the beams crossing them are re-traced */
+  void restore(const FieldState& state);
+
+  void fail() { if (trace) trace->failed = true; else failed = true; }
   bool isFailed() const { return failed; }
+  bool isFailing() const { return failing; }
   bool isWon() const { return won; }
+  u32 tracedBeams() const { return beams; }
+  u64 hash() const { return _hash; }
   
-  void place(Position p, Piece* piece)
+  void place(Position p, const Piece& piece)
   {
     Tile* tile = tileAt(p);
     tile->place(piece);
+    invalidate(p);
+  }
+  
+  /* every change to a tile must be reported here so that hash() stays current, when incremental mode
+     is enabled next updateLasers() also re-traces only the sources whose beams crossed a changed field tile */
+  void setIncremental(bool value) { incremental = value; tracesValid = false; boardValid = false; }
+  /* when enabled updateLasers() traces every source at once with BitboardTracer, which gives the same lasers, goals and
+     failures, fields larger than a Bitboard and pieces missing from TransitionTable fall back to tracing each source */
+  void setBitboard(bool value) { bitboard = value && BitboardTracer::fits(_width, _height); boardValid = false; }
+  /* when enabled each source traces the R, G and B channels of its beams together, a channel which already entered a tile
+     in a direction is dropped from the beams entering it again, so channels split and merged by prisms, filters and
+     splitters are traced once. A source whose beams reach a piece mixing channels is traced again with exact colors.
+     Lasers, goals and failures are the same either way, BitboardTracer always uses exact colors. */
+  void setPackedChannels(bool value) { packedChannels = value; tracesValid = false; }
+  /* when enabled load() builds a StaticScene of the level which traceSource() replays, it's off by default since it
+     only speeds up tracing a source and not whole updates, it takes effect on next load() */
+  void setStaticScene(bool value) { staticScene = value && StaticScene::fits(_width, _height); if (!staticScene) scene.suspend(); }
+  void invalidate(Position p)
+  {
+    const Tile* tile = tileAt(p);
+    
+    if (!tile)
+      return;
+    
+    const size_t index = tile >= tiles.data() && tile < tiles.data() + tiles.size() ? tile - tiles.data() : tiles.size() + (tile - inventory.data());
+    const u64 key = zobrist.key(index, tile->piece());
+    _hash ^= tileKeys[index] ^ key;
+    tileKeys[index] = key;
+    
+    if ((incremental || bitboard) && !p.isInventory() && isInside(p))
+      changed.push_back(p.y * _width + p.x);
+  }
+  
+  Position positionOf(const Tile* tile) const
+  {
+    if (tile >= inventory.data() && tile < inventory.data() + inventory.size())
+      return Position(Position::Type::INVENTORY, tile->x, tile->y);
+    else
+      return Position(tile->x, tile->y);
   }
   
   inline const Tile* tileAt(Position p) const {
@@ -172,6 +349,8 @@ public:
   }
 
   void generateBeam(Position position, Direction direction, LaserColor color);
+  /* tiles a piece looks at while a source is traced without a beam crossing them, so that changing them re-traces the source */
+  void touch(Position position) { if (trace && isInside(position)) trace->touched[position.y*_width + position.x] = true; }
   void updateLasers();
 
   void checkForWin();
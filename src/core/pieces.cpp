@@ -10,6 +10,7 @@
 
 #include "level.h"
 
+#include <array>
 #include <unordered_map>
 
 /* TODO: broken for flipped prism */
@@ -301,34 +302,75 @@ const PieceMechanics* PieceMechanics::mechanicsForType(PieceType type)
 
     { PIECE_TNT, PieceMechanics(false, false, never(), [](Field* field, const Piece* piece, Laser& laser) { field->fail(); }) },
 
-   };
+    { PIECE_ROUND_FILTER, PieceMechanics(true, false, 
+      [](const Piece* piece, const Laser& laser)
+      {
+        int delta = piece->deltaDirection(laser) % 4;
+        if (delta < 0) delta += 4;
 
-  auto it = mechanics.find(type);
+        switch (delta) {
+          case 0: return (laser.color & LaserColor::RED) == LaserColor::NONE;
+          case 1: return (laser.color & LaserColor::GREEN) == LaserColor::NONE;
+          case 2: return (laser.color & LaserColor::BLUE) == LaserColor::NONE;
+          default: return true;
+        }
+      },
+      [](Field* field, const Piece* piece, Laser& laser)
+      {
+        int delta = piece->deltaDirection(laser) % 4;
+        if (delta < 0) delta += 4;
 
-  return it != mechanics.end() ? &it->second : nullptr;
-}
+        switch (delta) {
+          case 0: laser.color = static_cast<LaserColor>(laser.color & LaserColor::RED); break;
+          case 1: laser.color = static_cast<LaserColor>(laser.color & LaserColor::GREEN); break;
+          case 2: laser.color = static_cast<LaserColor>(laser.color & LaserColor::BLUE); break;
+        }
+      })
+    },
 
-void Teleporter::receiveLaser(Field* field, Laser &laser)
-{
-  Direction dir = laser.direction;
-  Position p = laser.position;
+    { PIECE_CROSS_COLOR_INVERTER, PieceMechanics(true, false, never(), [](Field* field, const Piece* piece, Laser& laser)
+      {
+        if (piece->deltaDirection(laser) % 2 != 0)
+          laser.invalidate();
+        else
+          laser.color = static_cast<LaserColor>(~laser.color & LaserColor::WHITE);
+      })
+    },
 
-  p += dir;
-  
-  while (field->isInside(p))
-  {
-    Tile *tile = field->tileAt(p);
-    
-    if (tile->piece() && tile->piece()->type() == PIECE_TELEPORTER)
-    {
-      field->generateBeam(p, laser.direction, laser.color);
-      break;
-    }
-    
-    p += dir;
-  }
-  
-  laser.invalidate();
-}
+    { PIECE_TELEPORTER, PieceMechanics(false, false, never(), [](Field* field, const Piece* piece, Laser& laser)
+      {
+        Position p = laser.position + laser.direction;
+
+        while (field->isInside(p))
+        {
+          const Piece* other = field->tileAt(p)->piece();
+
+          // placing or removing a teleporter on the scanned tiles moves the exit
+          field->touch(p);
+
+          if (other && other->type() == PIECE_TELEPORTER)
+          {
+            field->generateBeam(p, laser.direction, laser.color);
+            break;
+          }
 
-Goal::Goal(PieceType type, LaserColor color) : Piece(type, NORTH, color), satisfied(false), satisfyDirection(0), satisfyColor(LaserColor::NONE) { }
+          p += laser.direction;
+        }
+
+        laser.invalidate();
+      })
+    },
+
+   };
+
+  /* looked up for every beam entering a piece so it's indexed by type instead of hashed */
+  static const std::array<const PieceMechanics*, PIECES_COUNT> byType = [] {
+    std::array<const PieceMechanics*, PIECES_COUNT> byType;
+    byType.fill(nullptr);
+    for (const auto& entry : mechanics)
+      byType[entry.first] = &entry.second;
+    return byType;
+  }();
+
+  return type < PIECES_COUNT ? byType[type] : nullptr;
+}
@@ -55,15 +55,6 @@ struct Laser
   }
   
   bool operator==(const Laser &o) const { return (position.x == o.position.x && position.y == o.position.y && color == o.color && direction == o.direction); }
-  
-  struct hash
-  {
-  public:
-    size_t operator()(const Laser& k) const
-    {
-      return (k.position.x << 24) | (k.position.y << 16) | ((size_t)k.color << 8) | k.direction;
-    }
-  };
 };
 
 class Piece;
@@ -105,73 +96,77 @@ private:
   static inline blocks_laser_predicate never() { return [](const Piece*, const Laser&) { return false;  }; }
 };
 
-class Tile;
-
 class Piece
 {
-protected:
-  const PieceMechanics* mechanics;
+public:
+  static constexpr PieceType NONE = PIECES_COUNT;
+
+private:
+  enum Flags : u8
+  {
+    MOVABLE   = 0x01,
+    ROTATABLE = 0x02,
+    COLORABLE = 0x04,
+    INFINITE  = 0x08
+  };
+  
+  /* packed into a few bytes so that tiles store pieces by value */
   PieceType type_;
-  Direction rotation_;
+  u8 rotation_;
   LaserColor color_;
-  bool movable, roteable, colorable, infinite;
+  u8 flags_;
+  
+  void setFlag(Flags flag, bool value) { flags_ = value ? (flags_ | flag) : (flags_ & ~flag); }
+  const PieceMechanics* mechanics() const { return PieceMechanics::mechanicsForType(type_); }
   
 public:
+  Piece() : type_(NONE), rotation_(NORTH), color_(LaserColor::NONE), flags_(0) { }
   Piece(PieceType type) : Piece(type, Dir::NORTH, LaserColor::NONE) { }
   Piece(PieceType type, Dir orientation) : Piece(type, orientation, LaserColor::NONE) { }
   Piece(PieceType type, LaserColor color) : Piece(type, Dir::NORTH, color) { }
 
   Piece(PieceType type, Direction orientation, LaserColor color) :
-    mechanics(PieceMechanics::mechanicsForType(type)),
-    type_(type), rotation_(orientation), color_(color),
-    movable(true), roteable(true), infinite(false), colorable(false)
+    type_(type), rotation_(orientation), color_(color), flags_(MOVABLE | ROTATABLE)
   { 
-    if (mechanics)
+    if (mechanics())
     {
-      assert(mechanics->canBeRotated() || orientation == Dir::NORTH);
-      assert(mechanics->canBeColored() || color == LaserColor::NONE);
+      assert(mechanics()->canBeRotated() || orientation == Dir::NORTH);
+      assert(mechanics()->canBeColored() || color == LaserColor::NONE);
     }
   }
   
-  Piece* dupe() const {
-    Piece* piece = new Piece(type_);
-    piece->mechanics = this->mechanics;
-    piece->rotation_ = this->rotation_;
-    piece->color_ = this->color_;
-    piece->movable = this->movable;
-    piece->roteable = this->roteable;
-    piece->colorable = this->colorable;
-    piece->infinite = this->infinite;
-    return piece;
-  }
-
-  virtual ~Piece() { }
+  bool empty() const { return type_ == NONE; }
   
-  Direction orientation() const { return rotation_;  }
-  Direction rotation() const { return rotation_; }
+  bool operator==(const Piece& o) const { return type_ == o.type_ && rotation_ == o.rotation_ && color_ == o.color_ && flags_ == o.flags_; }
+  bool operator!=(const Piece& o) const { return !(*this == o); }
+  
+  Direction orientation() const { return static_cast<Direction>(rotation_);  }
+  Direction rotation() const { return static_cast<Direction>(rotation_); }
   PieceType type() const { return type_; }
   LaserColor color() const { return color_; }
+  bool isGoal() const { return type_ == PIECE_STRICT_GOAL || type_ == PIECE_LOOSE_GOAL; }
   
-  void rotateLeft() { rotation_ = rotation_ == NORTH ? NORTH_WEST : static_cast<Direction>(rotation_-1); }
-  void rotateRight() { rotation_ = rotation_ == NORTH_WEST ? NORTH : static_cast<Direction>(rotation_+1); }
+  void rotateLeft() { rotation_ = rotation_ == NORTH ? NORTH_WEST : rotation_-1; }
+  void rotateRight() { rotation_ = rotation_ == NORTH_WEST ? NORTH : rotation_+1; }
   void setOrientation(Direction orientation) { rotation_ = orientation; }
   void setColor(LaserColor color) { color_ = color;  }
   
-  virtual Laser produceLaser() const { 
-    return mechanics ? mechanics->onLaserGeneration(this) : Laser(Pos::invalid(), Direction::NORTH, LaserColor::NONE);
+  Laser produceLaser() const { 
+    return mechanics() ? mechanics()->onLaserGeneration(this) : Laser(Pos::invalid(), Direction::NORTH, LaserColor::NONE);
   }
-  virtual bool blocksLaser(const Laser &laser) { return mechanics ? mechanics->doesBlockLaser(this, laser) : false; }
-  virtual void receiveLaser(Field* field, Laser& laser) { if (mechanics) mechanics->onLaserReceive(field, this, laser); }
+  bool blocksLaser(const Laser &laser) const { return mechanics() ? mechanics()->doesBlockLaser(this, laser) : false; }
+  void receiveLaser(Field* field, Laser& laser) const { if (mechanics()) mechanics()->onLaserReceive(field, this, laser); }
   
-  void setCanBeMoved(bool value) { movable = value; };
-  void setCanBeRotated(bool value) { roteable = value; }
-  void setInfinite(bool value) { infinite = value; }
-  void setCanBeColored(bool value) { colorable = value;  }
+  void setCanBeMoved(bool value) { setFlag(MOVABLE, value); };
+  void setCanBeRotated(bool value) { setFlag(ROTATABLE, value); }
+  void setInfinite(bool value) { setFlag(INFINITE, value); }
+  void setCanBeColored(bool value) { setFlag(COLORABLE, value);  }
   
-  virtual bool canBeMoved() const { return movable; }
-  virtual bool canBeRotated() const { return roteable; }
-  bool canBeColored() const { return colorable; }
-  bool isInfinite() const { return infinite; }
+  bool canBeMoved() const { return flags_ & MOVABLE; }
+  /* teleporters and mines can't be rotated whatever the level says */
+  bool canBeRotated() const { return (flags_ & ROTATABLE) && type_ != PIECE_TELEPORTER && type_ != PIECE_MINE; }
+  bool canBeColored() const { return flags_ & COLORABLE; }
+  bool isInfinite() const { return flags_ & INFINITE; }
   
   int deltaDirection(const Laser& laser) const
   {
@@ -185,132 +180,4 @@ public:
   }
 };
 
-
-class RoundFilter : public Piece
-{
-public:
-  RoundFilter() : Piece(PIECE_FILTER, NORTH, LaserColor::NONE) { }
-  
-  bool blocksLaser(const Laser &laser) override
-  {
-    int delta = deltaDirection(laser) % 4;
-    if (delta < 0) delta += 4;
-    
-    if (delta == 3)
-      return true;
-    else if (delta == 0)
-      return (laser.color & LaserColor::RED) == LaserColor::NONE;
-    else if (delta == 1)
-      return (laser.color & LaserColor::GREEN) == LaserColor::NONE;
-    else if (delta == 2)
-      return (laser.color & LaserColor::BLUE) == LaserColor::NONE;
-    else return true;
-  }
-  
-  void receiveLaser(Field* field, Laser &laser) override
-  {
-    int delta = deltaDirection(laser) % 4;
-    if (delta < 0) delta += 4;
-    
-    if (delta == 0)
-      laser.color = static_cast<LaserColor>(laser.color & LaserColor::RED);
-    else if (delta == 1)
-      laser.color = static_cast<LaserColor>(laser.color & LaserColor::GREEN);
-    else if (delta == 2)
-      laser.color = static_cast<LaserColor>(laser.color & LaserColor::BLUE);
-  }
-};
-
-class CrossColorInverter : public Piece
-{
-public:
-  CrossColorInverter(Direction rotation) : Piece(PIECE_CROSS_COLOR_INVERTER, rotation, LaserColor::NONE) { }
-  
-  void receiveLaser(Field* field, Laser &laser) override
-  {
-    int delta = deltaDirection(laser);
-    
-    if (delta%2 != 0)
-      laser.invalidate();
-    else
-    {
-      laser.color = static_cast<LaserColor>(~laser.color & LaserColor::WHITE);
-    }
-  }
-};
-
-
-class Teleporter : public Piece
-{
-public:
-  Teleporter() : Piece(PIECE_TELEPORTER, NORTH, LaserColor::NONE) { }
-  
-  void receiveLaser(Field* field, Laser &laser) override;
-  
-  bool canBeRotated() const override { return false; }
-};
-
-class Slime : public Piece
-{
-public:
-  Slime() : Piece(PIECE_SLIME, NORTH, LaserColor::NONE) { }
-  
-  void receiveLaser(Field* field, Laser &laser) override { UNUSED(laser); }; // TODO
-};
-
-class Mine : public Piece
-{
-public:
-  Mine() : Piece(PIECE_MINE, NORTH, LaserColor::NONE) { }
-  
-  void receiveLaser(Field* field, Laser &laser) override { UNUSED(laser); }; // TODO
-  
-  bool canBeRotated() const override { return false; }
-};
-
-
-
-class Goal : public Piece
-{
-protected:
-  bool satisfied;
-  u8 satisfyDirection;
-  LaserColor satisfyColor;
-  
-public:
-  Goal(PieceType type, LaserColor color);
-  
-  bool isSatisfied() const { return satisfied; }
-  void reset() {
-    satisfied = color_ == LaserColor::NONE;
-    satisfyColor = LaserColor::NONE;
-    satisfyDirection = 0;
-  }
-};
-
-class StrictGoal : public Goal
-{
-private:
-  
-public:
-  StrictGoal(LaserColor color) : Goal(PIECE_STRICT_GOAL, color) { }
-  
-  void receiveLaser(Field* field, Laser &laser)
-  {
-    satisfyColor = static_cast<LaserColor>(satisfyColor | laser.color);
-    satisfyDirection |= 1 << laser.direction;
-    
-    u8 foundDirections = 0;
-    for (int i = 0; i < 4; ++i)
-      if ((satisfyDirection & 1<<(4+i)) || (satisfyDirection & 1<<(i)))
-        ++foundDirections;
-    
-    if (color_ == LaserColor::NONE)
-      satisfied = satisfyColor == LaserColor::NONE && foundDirections == 0;
-    else
-      satisfied = satisfyColor == color_ && foundDirections == 1;
-  }
-};
-
-
 #endif
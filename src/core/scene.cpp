@@ -0,0 +1,139 @@
+#include "scene.h"
+
+void StaticScene::build(const Board& board)
+{
+  built = false;
+
+  if (!fits(width, height))
+    return;
+
+  building.resize(width*height);
+
+  for (u32 i = 0; i < width*height; ++i)
+  {
+    const bool locked = !(board.flags[i] & (Board::MOVABLE | Board::ROTATABLE));
+    building[i] = board.empty(i) || locked ? board.rows[i] : TransitionTable::NO_ROW;
+  }
+
+  // restarting a level finds the segments it compiled the last time
+  if (building != rows)
+  {
+    for (u32 entry : compiled)
+      entries[entry] = NO_SEGMENT;
+
+    compiled.clear();
+    segments.clear();
+    halves.clear();
+    exits.clear();
+    hits.clear();
+
+    rows.swap(building);
+    entries.resize(width*height*64, NO_SEGMENT);
+    visited.resize(width*height, 0);
+    lasers.resize(width*height, 0);
+  }
+
+  altered = Bitboard::none();
+  built = true;
+}
+
+u32 StaticScene::compile(u32 index, Direction direction, LaserColor color)
+{
+  const TransitionTable& table = TransitionTable::instance();
+  Segment segment = { Bitboard::none(), static_cast<u32>(halves.size()), 0, static_cast<u32>(exits.size()), 0, static_cast<u32>(hits.size()), 0, false, false };
+
+  auto light = [this, &segment] (u32 tile, u32 halves) {
+    if (!segment.tiles.test(tile))
+    {
+      segment.tiles.set(tile);
+      lit.push_back(tile);
+    }
+
+    lasers[tile] |= halves;
+  };
+
+  // same rules as Field::traceSource() for tabulated pieces, but every tile is visited on its own
+  pending.push_back(Laser(Position(index % width, index / width), direction, color));
+
+  while (!pending.empty())
+  {
+    Laser laser = pending.back();
+    pending.pop_back();
+
+    while (isInside(laser.position))
+    {
+      const u32 tile = laser.position.y*width + laser.position.x;
+      const u16 row = rows[tile];
+
+      if (row == TransitionTable::NO_ROW)
+      {
+        exits.push_back(laser);
+        break;
+      }
+
+      const u64 mark = u64(1) << (laser.direction*8 + laser.color);
+
+      if (visited[tile] & mark)
+        break;
+
+      visited[tile] |= mark;
+      light(tile, 0);
+
+      if (row == Board::EMPTY_ROW)
+      {
+        light(tile, Board::laser((laser.direction+4)%8, laser.color) | Board::laser(laser.direction, laser.color));
+        laser.advance();
+        continue;
+      }
+
+      const Transition& transition = table.at(row, laser.direction, laser.color);
+
+      segment.mixing |= table.mixes(row);
+
+      if (transition.blocked())
+        break;
+
+      light(tile, Board::laser((laser.direction+4)%8, laser.color));
+
+      if (transition.flags & Transition::GOAL)
+        hits.push_back(laser);
+      if (transition.flags & Transition::FAIL)
+        segment.failed = true;
+
+      for (u8 i = 0; i < transition.count; ++i)
+      {
+        const Direction direction = Transition::direction(transition.beams[i]);
+        const Laser beam = Laser(laser.position + direction, direction, Transition::color(transition.beams[i]));
+
+        if (isInside(beam.position))
+        {
+          pending.push_back(beam);
+          light(tile, Board::laser(direction, beam.color));
+        }
+      }
+
+      if (!transition.continues())
+        break;
+
+      laser.direction = Transition::direction(transition.next);
+      laser.color = Transition::color(transition.next);
+      light(tile, Board::laser(laser.direction, laser.color));
+      laser.advance();
+    }
+  }
+
+  for (u32 tile : lit)
+  {
+    halves.push_back({ tile, lasers[tile] });
+    visited[tile] = 0;
+    lasers[tile] = 0;
+  }
+
+  lit.clear();
+
+  segment.lastHalf = static_cast<u32>(halves.size());
+  segment.lastExit = static_cast<u32>(exits.size());
+  segment.lastHit = static_cast<u32>(hits.size());
+  segments.push_back(segment);
+  return static_cast<u32>(segments.size() - 1);
+}
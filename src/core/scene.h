@@ -0,0 +1,108 @@
+#pragma once
+
+#include "bitboard.h"
+#include "board.h"
+#include "pieces.h"
+#include "transitions.h"
+
+#include <vector>
+
+/* fixed part of a loaded level, the locked pieces and the tiles which were empty, compiled into segments: a beam
+   entering a fixed tile is followed once across the fixed tiles and later traces replay what it lit, the goals it hit
+   and the beams it handed over to the other tiles. A segment is replayed as long as none of the tiles it crossed
+   changed since the scene was built. Tiles are bits of Bitboard by index rather than by position, so fields of more than
+   256 tiles have no scene. */
+class StaticScene
+{
+public:
+  struct Half
+  {
+    u32 index;
+    u32 lasers;
+  };
+
+  struct Segment
+  {
+    /* tiles crossed by the beams of the segment */
+    Bitboard tiles;
+    u32 firstHalf, lastHalf;
+    u32 firstExit, lastExit;
+    u32 firstHit, lastHit;
+    bool failed;
+    /* a beam of the segment entered a piece which mixes color channels, see TransitionTable::mixes() */
+    bool mixing;
+  };
+
+private:
+  static constexpr u32 NO_SEGMENT = ~0U;
+
+  u32 width, height;
+  bool built;
+  /* rows of the fixed tiles when the scene was built, NO_ROW for the other tiles */
+  std::vector<u16> rows;
+  std::vector<u16> building;
+  /* fixed tiles whose row differs from the built one */
+  Bitboard altered;
+
+  /* segment of each entry by (index*8 + direction)*8 + color, compiled the first time a beam enters it */
+  std::vector<u32> entries;
+  std::vector<u32> compiled;
+  std::vector<Segment> segments;
+  std::vector<Half> halves;
+  /* beams leaving a segment, positioned on the tile which isn't fixed they enter */
+  std::vector<Laser> exits;
+  std::vector<Laser> hits;
+
+  std::vector<u64> visited;
+  std::vector<u32> lasers;
+  std::vector<u32> lit;
+  std::vector<Laser> pending;
+
+  bool isInside(const Position& p) const { return p.x >= 0 && p.x < s32(width) && p.y >= 0 && p.y < s32(height); }
+  u32 compile(u32 index, Direction direction, LaserColor color);
+
+public:
+  StaticScene(u32 width, u32 height) : width(width), height(height), built(false), altered(Bitboard::none()) { }
+
+  static bool fits(u32 width, u32 height) { return width*height <= Bitboard::SIDE*Bitboard::SIDE; }
+
+  /* pieces which can't be moved nor rotated and empty tiles of the board are fixed, pieces missing from TransitionTable
+     aren't, segments are kept when the fixed tiles are the same as the last time the scene was built */
+  void build(const Board& board);
+  /* the scene isn't followed until it's built again */
+  void suspend() { built = false; }
+
+  /* must be told the row of a tile each time it changes */
+  void update(u32 index, u16 row)
+  {
+    if (!built || rows[index] == TransitionTable::NO_ROW)
+      return;
+
+    if (row != rows[index])
+      altered.set(index);
+    else
+      altered.reset(index);
+  }
+
+  /* segment of a beam entering a fixed tile, nullptr when the tile isn't fixed or the segment crosses an altered tile */
+  const Segment* follow(u32 index, Direction direction, LaserColor color)
+  {
+    if (!built || rows[index] == TransitionTable::NO_ROW)
+      return nullptr;
+
+    u32& entry = entries[(index*8 + direction)*8 + color];
+
+    if (entry == NO_SEGMENT)
+    {
+      entry = compile(index, direction, color);
+      compiled.push_back((index*8 + direction)*8 + color);
+    }
+
+    const Segment& segment = segments[entry];
+    return (segment.tiles & altered).any() ? nullptr : &segment;
+  }
+
+  const Half& half(u32 i) const { return halves[i]; }
+  const Laser& exit(u32 i) const { return exits[i]; }
+  const Laser& hit(u32 i) const { return hits[i]; }
+};
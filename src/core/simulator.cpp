@@ -0,0 +1,220 @@
+#include "simulator.h"
+
+Simulator::Simulator(u32 width, u32 height, u32 invWidth, u32 invHeight) : _field(width, height, invWidth, invHeight), dirty(false)
+{
+  _field.setIncremental(true);
+}
+
+bool Simulator::isPlayable(Position position) const
+{
+  return position.isValid() && _field.tileAt(position);
+}
+
+bool Simulator::load(const LevelRef& level)
+{
+  if (!level)
+    return false;
+
+  _field.reset();
+  _field.load(level);
+  _field.checkForWin();
+  dirty = false;
+  return true;
+}
+
+void Simulator::reset()
+{
+  _field.reset();
+  dirty = true;
+}
+
+bool Simulator::move(Position from, Position to)
+{
+  if (!isPlayable(from) || !isPlayable(to))
+    return false;
+
+  Tile* source = _field.tileAt(from);
+  Tile* destination = _field.tileAt(to);
+
+  if (source == destination || !source->piece() || !source->piece()->canBeMoved())
+    return false;
+
+  if (source->piece()->isInfinite())
+  {
+    if (destination->piece())
+      return false;
+
+    Piece copy = *source->piece();
+    copy.setInfinite(false);
+    _field.place(to, copy);
+  }
+  else
+  {
+    if (destination->piece() && !destination->piece()->canBeMoved())
+      return false;
+
+    source->swap(destination);
+    _field.invalidate(from);
+    _field.invalidate(to);
+  }
+
+  dirty = true;
+  return true;
+}
+
+bool Simulator::rotate(Position position, Direction orientation)
+{
+  Piece* piece = isPlayable(position) ? _field.tileAt(position)->piece() : nullptr;
+
+  if (!piece)
+    return false;
+  else if (piece->orientation() == orientation)
+    return true;
+  else if (!piece->canBeRotated())
+    return false;
+
+  piece->setOrientation(orientation);
+  _field.invalidate(position);
+  dirty = true;
+  return true;
+}
+
+bool Simulator::setColor(Position position, LaserColor color)
+{
+  Piece* piece = isPlayable(position) ? _field.tileAt(position)->piece() : nullptr;
+
+  if (!piece)
+    return false;
+  else if (piece->color() == color)
+    return true;
+  else if (!piece->canBeColored())
+    return false;
+
+  piece->setColor(color);
+  _field.invalidate(position);
+  dirty = true;
+  return true;
+}
+
+bool Simulator::apply(const Placement& placement)
+{
+  if (placement.from != placement.to && !move(placement.from, placement.to))
+    return false;
+
+  return rotate(placement.to, placement.orientation);
+}
+
+void Simulator::update()
+{
+  if (!dirty)
+    return;
+
+  _field.updateLasers();
+  _field.checkForWin();
+  dirty = false;
+}
+
+void Simulator::restore(const FieldState& state)
+{
+  _field.restore(state);
+  dirty = false;
+}
+
+const Piece* Simulator::pieceAt(Position position) const
+{
+  return isPlayable(position) ? _field.tileAt(position)->piece() : nullptr;
+}
+
+LaserColor Simulator::laserAt(Position position, Direction direction) const
+{
+  if (!_field.isInside(position) || position.isInventory())
+    return LaserColor::NONE;
+
+  return Board::laserColor(board().lasers[position.y*_field.width() + position.x], direction);
+}
+
+bool Simulator::isSatisfied(Position position) const
+{
+  if (!_field.isInside(position) || position.isInventory())
+    return false;
+
+  return board().flags[position.y*_field.width() + position.x] & Board::SATISFIED;
+}
+
+size_t Simulator::goalCount() const
+{
+  return _field.goalStates().size();
+}
+
+static void formatPosition(std::string& text, Position position)
+{
+  if (position.isInventory())
+    text += 'i';
+  text += std::to_string(position.x) + "." + std::to_string(position.y);
+}
+
+std::string Simulator::formatPlacements(const std::vector<Placement>& placements)
+{
+  std::string text;
+
+  for (const Placement& placement : placements)
+  {
+    if (!text.empty())
+      text += ' ';
+    formatPosition(text, placement.from);
+    text += '>';
+    formatPosition(text, placement.to);
+    text += '@' + std::to_string(placement.orientation);
+  }
+
+  return text;
+}
+
+static bool parseNumber(const char*& p, s32& value)
+{
+  if (*p < '0' || *p > '9')
+    return false;
+
+  value = 0;
+  while (*p >= '0' && *p <= '9' && value < 0x1000)
+    value = value*10 + (*p++ - '0');
+
+  return true;
+}
+
+static bool parsePosition(const char*& p, Position& position)
+{
+  const bool inventory = *p == 'i';
+  s32 x, y;
+
+  if (inventory)
+    ++p;
+
+  if (!parseNumber(p, x) || *p++ != '.' || !parseNumber(p, y))
+    return false;
+
+  position = inventory ? Position(Position::Type::INVENTORY, x, y) : Position(x, y);
+  return true;
+}
+
+bool Simulator::parsePlacements(const std::string& text, std::vector<Placement>& placements)
+{
+  const char* p = text.c_str();
+
+  placements.clear();
+
+  while (*p)
+  {
+    Position from = Position::invalid(), to = Position::invalid();
+    s32 orientation;
+
+    if (*p == ' ')
+      ++p;
+    else if (parsePosition(p, from) && *p++ == '>' && parsePosition(p, to) && *p++ == '@' && parseNumber(p, orientation) && orientation < 8)
+      placements.emplace_back(from, to, static_cast<Direction>(orientation));
+    else
+      return false;
+  }
+
+  return true;
+}
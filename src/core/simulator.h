@@ -0,0 +1,65 @@
+#pragma once
+
+#include "level.h"
+
+#include <string>
+
+/* a piece moved to a field position with a given orientation, as stored in a solution */
+struct Placement
+{
+  Position from;
+  Position to;
+  Direction orientation;
+
+  Placement(Position from, Position to, Direction orientation) : from(from), to(to), orientation(orientation) { }
+};
+
+/* entry point to the simulation for tools that don't open a window, placements follow the
+   same rules as the game and lasers are re-traced incrementally when update() is called */
+class Simulator
+{
+private:
+  Field _field;
+  bool dirty;
+
+  bool isPlayable(Position position) const;
+
+public:
+  static constexpr u32 WIDTH = 16, HEIGHT = 11, INV_WIDTH = 4, INV_HEIGHT = 11;
+
+  Simulator() : Simulator(WIDTH, HEIGHT, INV_WIDTH, INV_HEIGHT) { }
+  Simulator(u32 width, u32 height, u32 invWidth, u32 invHeight);
+
+  /* pieces outside of the field are dropped as Field::load() does, it only fails without a level */
+  bool load(const LevelRef& level);
+  void reset();
+
+  bool move(Position from, Position to);
+  bool rotate(Position position, Direction orientation);
+  bool setColor(Position position, LaserColor color);
+  bool apply(const Placement& placement);
+
+  void update();
+  /* see Field::setBitboard(), takes effect on next update */
+  void setBitboard(bool value) { _field.setBitboard(value); dirty = true; }
+
+  /* snapshots taken repeatedly into the same state don't allocate, restoring also updates lasers */
+  void snapshot(FieldState& state) const { _field.snapshot(state); }
+  void restore(const FieldState& state);
+
+  const Piece* pieceAt(Position position) const;
+  LaserColor laserAt(Position position, Direction direction) const;
+  bool isSatisfied(Position position) const;
+  size_t goalCount() const;
+  bool isWon() const { return _field.isWon(); }
+  bool isFailed() const { return _field.isFailed(); }
+  /* identifies the configuration of the pieces, it's current even before update() */
+  u64 hash() const { return _field.hash(); }
+
+  const Board& board() const { return _field.board(); }
+  const Field& field() const { return _field; }
+
+  /* text form of a solution, placements are separated by spaces and written as i0.0>10.10@0 where i marks inventory positions */
+  static std::string formatPlacements(const std::vector<Placement>& placements);
+  static bool parsePlacements(const std::string& text, std::vector<Placement>& placements);
+};
@@ -0,0 +1,665 @@
+#include "solver.h"
+
+#include <algorithm>
+#include <thread>
+
+Solver::Solver(const LevelRef& level, Options options) : level(level), options(options),
+  litWords(0), pending(0), nodes(0), stop(false), aborted(false), solved(false)
+{
+
+}
+
+bool Solver::isSolved(const Simulator& simulator) const
+{
+  return simulator.isWon() && !simulator.field().isFailing();
+}
+
+/* satisfied goals count most, other goals count the channels they need which reach them minus the others,
+   failing boards come last since only a later piece blocking the failing beam can save them */
+s32 Solver::score(const Simulator& simulator) const
+{
+  const Field& field = simulator.field();
+  s32 total = 0;
+
+  for (const GoalState& goal : field.goalStates())
+  {
+    const u32 wanted = simulator.board().colors[goal.index];
+
+    if (goal.satisfied)
+      total += 4;
+    else
+      total += __builtin_popcount(goal.colors & wanted) - __builtin_popcount(goal.colors & ~wanted & LaserColor::WHITE);
+  }
+
+  return field.isFailing() ? total - 4*s32(field.goalStates().size()) - 4 : total;
+}
+
+void Solver::push(Worker& worker, Task task)
+{
+  ++pending;
+  std::lock_guard<std::mutex> guard(worker.lock);
+  worker.tasks.push_back(std::move(task));
+}
+
+bool Solver::pop(Worker& worker, Task& task)
+{
+  std::lock_guard<std::mutex> guard(worker.lock);
+
+  if (worker.tasks.empty())
+    return false;
+
+  // the owner works depth first on the newest tasks
+  task = std::move(worker.tasks.back());
+  worker.tasks.pop_back();
+  return true;
+}
+
+bool Solver::steal(size_t thief, Task& task)
+{
+  for (size_t i = 1; i < workers.size(); ++i)
+  {
+    Worker& victim = *workers[(thief + i) % workers.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+
+    // oldest tasks are the closest to the root so they carry the most work
+    if (!victim.tasks.empty())
+    {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool Solver::apply(Worker& worker, size_t variable, Position to, Direction orientation)
+{
+  const Position from = worker.positions[variable];
+  const Direction previous = worker.simulator.pieceAt(from)->orientation();
+
+  if (from != to && !worker.simulator.move(from, to))
+    return false;
+
+  if (!worker.simulator.rotate(to, orientation))
+  {
+    if (from != to)
+      worker.simulator.move(to, from);
+    return false;
+  }
+
+  worker.positions[variable] = to;
+  worker.path.emplace_back(from, to, orientation);
+  worker.orientations.push_back(previous);
+  return true;
+}
+
+void Solver::undo(Worker& worker)
+{
+  const Placement& placement = worker.path.back();
+
+  worker.simulator.rotate(placement.to, worker.orientations.back());
+  if (placement.from != placement.to)
+    worker.simulator.move(placement.to, placement.from);
+
+  worker.positions[worker.path.size() - 1] = placement.from;
+  worker.path.pop_back();
+  worker.orientations.pop_back();
+}
+
+template<typename F> void Solver::forEachOption(const Worker& worker, size_t index, F f)
+{
+  const Variable& variable = variables[index];
+  const Position position = worker.positions[index];
+  const Field& field = worker.simulator.field();
+  const Direction current = worker.simulator.pieceAt(position)->orientation();
+  const u32 rotations = variable.rotatable ? 8 : 1;
+
+  auto orientation = [current] (u32 i) { return static_cast<Direction>((current + i) % 8); };
+
+  // rotations in place, the piece left untouched is the last option
+  if (!position.isInventory())
+    for (u32 r = 1; r < rotations && !stop; ++r)
+      f(position, orientation(r));
+
+  if (variable.movable)
+  {
+    for (u32 y = 0; y < field.height(); ++y)
+      for (u32 x = 0; x < field.width(); ++x)
+      {
+        const Position to = Position(x, y);
+
+        if (!field.tileAt(to)->empty())
+          continue;
+
+        for (u32 r = 0; r < rotations && !stop; ++r)
+          f(to, orientation(r));
+      }
+  }
+
+  if (!stop)
+    f(position, current);
+}
+
+/* the pieces alone don't tell which decisions are left: the hash is salted with the depth for the exhaustive
+   search, and for the pruned one with the tiles already changed, the lifting step and what the ordering rule
+   still allows, which is the tile of the last decision and the smaller tiles lit before it */
+u64 Solver::stateKey(const Worker& worker) const
+{
+  const u64 hash = worker.simulator.hash();
+  const size_t depth = worker.path.size();
+
+  if (options.mode == Mode::EXHAUSTIVE)
+    return hash ^ Zobrist::mix(depth + 1);
+
+  u64 key = hash ^ worker.changedKey ^ Zobrist::mix(std::min(depth, lifts.size()) + 1);
+  const s32 last = worker.keys.empty() ? -1 : worker.keys.back();
+
+  if (last >= 0)
+  {
+    key ^= Zobrist::mix(u64(last) << 32);
+
+    for (size_t i = 0; i <= size_t(last) >> 6; ++i)
+    {
+      const u64 bits = worker.lit[(depth - 1)*litWords + i];
+      const u64 below = (i == size_t(last) >> 6) ? bits & ((u64(1) << (last & 63)) - 1) : bits;
+      key = Zobrist::mix(key ^ below);
+    }
+  }
+
+  return key;
+}
+
+bool Solver::visit(Worker& worker)
+{
+  if (stop)
+    return false;
+
+  // states reached before are being or have been explored by some thread
+  if (table && !table->insert(stateKey(worker), worker.path.size()))
+    return false;
+
+  const u64 count = ++nodes;
+
+  if (options.maxNodes && count > options.maxNodes)
+  {
+    aborted = true;
+    stop = true;
+    return false;
+  }
+
+  worker.simulator.update();
+
+  if (isSolved(worker.simulator))
+  {
+    std::lock_guard<std::mutex> guard(solutionLock);
+
+    if (!solved)
+    {
+      solved = true;
+
+      // options which leave a piece untouched are part of the path but not of the solution
+      for (size_t i = 0; i < worker.path.size(); ++i)
+        if (worker.path[i].from != worker.path[i].to || worker.path[i].orientation != worker.orientations[i])
+          solution.push_back(worker.path[i]);
+    }
+
+    stop = true;
+    return false;
+  }
+
+  return true;
+}
+
+void Solver::search(Worker& worker, size_t depth)
+{
+  if (!visit(worker) || depth == variables.size())
+    return;
+
+  const bool split = depth < options.splitDepth && workers.size() > 1;
+
+  forEachOption(worker, depth, [&] (Position to, Direction orientation) {
+    if (split)
+    {
+      Task task = worker.path;
+      task.emplace_back(worker.positions[depth], to, orientation);
+      push(worker, std::move(task));
+    }
+    else if (apply(worker, depth, to, orientation))
+    {
+      search(worker, depth + 1);
+      undo(worker);
+    }
+  });
+}
+
+/* pieces whose behavior doesn't depend on receiving a beam on their tile */
+static bool emits(PieceType type)
+{
+  return type == PIECE_SOURCE || type == PIECE_TELEPORTER;
+}
+
+size_t Solver::groupOf(const Piece* piece) const
+{
+  for (size_t i = 0; i < groups.size(); ++i)
+  {
+    const Group& group = groups[i];
+
+    if (group.type == piece->type() && group.color == piece->color() && group.rotatable == piece->canBeRotated() &&
+        (group.rotatable || group.orientation == piece->orientation()))
+      return i;
+  }
+
+  return groups.size();
+}
+
+void Solver::mark(Worker& worker)
+{
+  const Board& board = worker.simulator.board();
+  const size_t base = worker.lit.size();
+
+  worker.lit.resize(base + litWords, 0);
+  for (u32 i = 0; i < board.size(); ++i)
+    if (board.lasers[i])
+      worker.lit[base + (i >> 6)] |= 1ULL << (i & 63);
+}
+
+bool Solver::isLit(const Worker& worker, size_t depth, u32 index) const
+{
+  return worker.lit[depth*litWords + (index >> 6)] & (1ULL << (index & 63));
+}
+
+/* decisions of the pruned search are stored as placements: a field piece kept or rotated in place has from == to,
+   an inventory piece placed on the field goes from its slot, a field piece lifted goes to a free inventory slot */
+bool Solver::applyPruned(Worker& worker, const Placement& placement)
+{
+  Simulator& simulator = worker.simulator;
+  const Field& field = simulator.field();
+  const bool lifting = worker.path.size() < lifts.size();
+  const Piece* piece = simulator.pieceAt(placement.from);
+
+  if (!piece)
+    return false;
+
+  const Direction previous = piece->orientation();
+  const size_t group = groupOf(piece);
+  const s32 key = lifting ? -1 : placement.to.y*field.width() + placement.to.x;
+
+  // tasks replay decisions without visiting their nodes, the ordering rule still needs what was lit there
+  if (worker.lit.size() == worker.path.size()*litWords)
+  {
+    simulator.update();
+    mark(worker);
+  }
+
+  if (lifting)
+  {
+    if (placement.from != placement.to && !simulator.move(placement.from, placement.to))
+      return false;
+    else if (placement.from != placement.to)
+      worker.slots[group].push_back(placement.to);
+  }
+  else if (placement.from.isInventory())
+  {
+    if (group == groups.size() || worker.slots[group].empty() || worker.slots[group].back() != placement.from ||
+        !simulator.move(placement.from, placement.to))
+      return false;
+    else if (!simulator.rotate(placement.to, placement.orientation))
+    {
+      simulator.move(placement.to, placement.from);
+      return false;
+    }
+
+    worker.slots[group].pop_back();
+    worker.changed[key] = true;
+    worker.changedKey ^= Zobrist::mix(~u64(key));
+  }
+  else
+  {
+    if (!simulator.rotate(placement.to, placement.orientation))
+      return false;
+
+    worker.changed[key] = true;
+    worker.changedKey ^= Zobrist::mix(~u64(key));
+  }
+
+  worker.path.push_back(placement);
+  worker.orientations.push_back(previous);
+  worker.keys.push_back(key);
+  return true;
+}
+
+void Solver::undoPruned(Worker& worker)
+{
+  Simulator& simulator = worker.simulator;
+  const Placement placement = worker.path.back();
+  const s32 key = worker.keys.back();
+
+  worker.path.pop_back();
+  worker.keys.pop_back();
+
+  if (key < 0)
+  {
+    if (placement.from != placement.to)
+    {
+      worker.slots[groupOf(simulator.pieceAt(placement.to))].pop_back();
+      simulator.move(placement.to, placement.from);
+    }
+  }
+  else
+  {
+    simulator.rotate(placement.to, worker.orientations.back());
+    worker.changed[key] = false;
+    worker.changedKey ^= Zobrist::mix(~u64(key));
+
+    if (placement.from != placement.to)
+    {
+      simulator.move(placement.to, placement.from);
+      worker.slots[groupOf(simulator.pieceAt(placement.from))].push_back(placement.from);
+    }
+  }
+
+  worker.orientations.pop_back();
+}
+
+template<typename F> void Solver::forEachDecision(const Worker& worker, F f)
+{
+  const Simulator& simulator = worker.simulator;
+  const Field& field = simulator.field();
+  const TransitionTable& transitions = TransitionTable::instance();
+  const size_t depth = worker.path.size();
+
+  // movable field pieces are first either kept or lifted to the inventory, where they join the other pieces
+  if (depth < lifts.size())
+  {
+    const Position origin = lifts[depth];
+    const Direction current = simulator.pieceAt(origin)->orientation();
+
+    f(Placement(origin, origin, current));
+
+    for (u32 y = 0; y < field.invHeight() && !stop; ++y)
+      for (u32 x = 0; x < field.invWidth(); ++x)
+        if (!simulator.pieceAt(Position(Position::Type::INVENTORY, x, y)))
+        {
+          f(Placement(origin, Position(Position::Type::INVENTORY, x, y), current));
+          return;
+        }
+
+    return;
+  }
+
+  /* a decision only matters on a lit tile unless the piece emits beams itself, and decisions which don't light
+     each other are taken in increasing tile order: after a decision on tile k, a smaller tile is only considered if k lit it */
+  const s32 last = worker.keys.empty() ? -1 : worker.keys.back();
+
+  for (u32 i = 0; i < field.width()*field.height() && !stop; ++i)
+  {
+    const bool lit = isLit(worker, depth, i);
+
+    if (worker.changed[i])
+      continue;
+    else if (static_cast<s32>(i) < last && !(lit && !isLit(worker, depth - 1, i)))
+      continue;
+
+    const Position position = Position(i % field.width(), i / field.width());
+    const Piece* piece = simulator.pieceAt(position);
+
+    if (piece)
+    {
+      if (!piece->canBeRotated() || piece->isInfinite() || (!lit && !emits(piece->type())))
+        continue;
+
+      const Direction current = transitions.representative(piece->type(), piece->orientation(), piece->color());
+
+      for (u32 r = 0; r < 8 && !stop; ++r)
+      {
+        const Direction rotation = static_cast<Direction>(r);
+        if (rotation != current && transitions.representative(piece->type(), rotation, piece->color()) == rotation)
+          f(Placement(position, position, rotation));
+      }
+
+      continue;
+    }
+
+    // one piece of each group is enough since identical pieces are interchangeable
+    for (size_t g = 0; g < groups.size() && !stop; ++g)
+    {
+      if (worker.slots[g].empty() || (!lit && !emits(groups[g].type)))
+        continue;
+
+      const Group& group = groups[g];
+      const Position slot = worker.slots[g].back();
+
+      if (!group.rotatable)
+      {
+        f(Placement(slot, position, group.orientation));
+        continue;
+      }
+
+      for (u32 r = 0; r < 8 && !stop; ++r)
+      {
+        const Direction rotation = static_cast<Direction>(r);
+        if (transitions.representative(group.type, rotation, group.color) == rotation)
+          f(Placement(slot, position, rotation));
+      }
+    }
+  }
+}
+
+void Solver::searchPruned(Worker& worker)
+{
+  if (!visit(worker))
+    return;
+
+  // the board is stale once children have been searched so decisions read the lit tiles recorded here
+  const size_t depth = worker.path.size();
+  worker.lit.resize(depth*litWords);
+  mark(worker);
+
+  const bool split = worker.path.size() < options.splitDepth && workers.size() > 1;
+
+  if (options.guided && !split)
+  {
+    std::vector<std::pair<s32, Placement>> decisions;
+
+    // each decision is tried once to score it, then searched by decreasing score, ties keep the usual order
+    forEachDecision(worker, [&] (const Placement& placement) {
+      if (applyPruned(worker, placement))
+      {
+        worker.simulator.update();
+        decisions.emplace_back(-score(worker.simulator), placement);
+        undoPruned(worker);
+      }
+    });
+
+    std::stable_sort(decisions.begin(), decisions.end(), [] (const std::pair<s32, Placement>& a, const std::pair<s32, Placement>& b) { return a.first < b.first; });
+
+    for (size_t i = 0; i < decisions.size() && !stop; ++i)
+      if (applyPruned(worker, decisions[i].second))
+      {
+        searchPruned(worker);
+        undoPruned(worker);
+      }
+
+    worker.lit.resize(depth*litWords);
+    return;
+  }
+
+  forEachDecision(worker, [&] (const Placement& placement) {
+    if (split)
+    {
+      Task task = worker.path;
+      task.push_back(placement);
+      push(worker, std::move(task));
+    }
+    else if (applyPruned(worker, placement))
+    {
+      searchPruned(worker);
+      undoPruned(worker);
+    }
+  });
+
+  worker.lit.resize(depth*litWords);
+}
+
+void Solver::execute(Worker& worker, const Task& task)
+{
+  const bool pruned = options.mode == Mode::PRUNED;
+  size_t applied = 0;
+
+  while (applied < task.size() && (pruned ? applyPruned(worker, task[applied]) : apply(worker, applied, task[applied].to, task[applied].orientation)))
+    ++applied;
+
+  if (applied == task.size())
+  {
+    if (pruned)
+      searchPruned(worker);
+    else
+      search(worker, applied);
+  }
+
+  while (applied--)
+  {
+    if (pruned)
+      undoPruned(worker);
+    else
+      undo(worker);
+  }
+
+  worker.lit.clear();
+}
+
+void Solver::run(size_t index)
+{
+  Worker& worker = *workers[index];
+  Task task;
+
+  while (!stop)
+  {
+    if (pop(worker, task) || steal(index, task))
+    {
+      execute(worker, task);
+      --pending;
+    }
+    else if (pending == 0)
+      break;
+    else
+      std::this_thread::yield();
+  }
+}
+
+void Solver::prepareExhaustive(const Simulator& simulator)
+{
+  const Field& field = simulator.field();
+
+  // infinite pieces would spawn unbounded copies so only regular pieces are searched
+  for (u32 y = 0; y < field.invHeight(); ++y)
+    for (u32 x = 0; x < field.invWidth(); ++x)
+    {
+      const Piece* piece = simulator.pieceAt(Position(Position::Type::INVENTORY, x, y));
+      if (piece && piece->canBeMoved() && !piece->isInfinite())
+        variables.push_back({ Position(Position::Type::INVENTORY, x, y), true, piece->canBeRotated() });
+    }
+
+  for (u32 y = 0; y < field.height(); ++y)
+    for (u32 x = 0; x < field.width(); ++x)
+    {
+      const Piece* piece = simulator.pieceAt(Position(x, y));
+      if (piece && !piece->isInfinite() && (piece->canBeMoved() || piece->canBeRotated()))
+        variables.push_back({ Position(x, y), piece->canBeMoved(), piece->canBeRotated() });
+    }
+}
+
+void Solver::preparePruned(const Simulator& simulator)
+{
+  const Field& field = simulator.field();
+
+  auto addGroup = [this] (const Piece* piece) {
+    if (groupOf(piece) == groups.size())
+    {
+      groups.push_back({ piece->type(), piece->color(), piece->canBeRotated(), piece->orientation() });
+      inventory.emplace_back();
+    }
+    return groupOf(piece);
+  };
+
+  for (u32 y = 0; y < field.invHeight(); ++y)
+    for (u32 x = 0; x < field.invWidth(); ++x)
+    {
+      const Position position = Position(Position::Type::INVENTORY, x, y);
+      const Piece* piece = simulator.pieceAt(position);
+      if (piece && piece->canBeMoved() && !piece->isInfinite())
+        inventory[addGroup(piece)].push_back(position);
+    }
+
+  // slots are used from the back, reversing them makes the search take pieces in inventory order
+  for (std::vector<Position>& slots : inventory)
+    std::reverse(slots.begin(), slots.end());
+
+  for (u32 y = 0; y < field.height(); ++y)
+    for (u32 x = 0; x < field.width(); ++x)
+    {
+      const Piece* piece = simulator.pieceAt(Position(x, y));
+      if (piece && piece->canBeMoved() && !piece->isInfinite())
+      {
+        addGroup(piece);
+        lifts.push_back(Position(x, y));
+      }
+    }
+
+  litWords = (field.width()*field.height() + 63) / 64;
+}
+
+bool Solver::solve()
+{
+  Simulator probe;
+
+  if (!probe.load(level))
+    return false;
+
+  variables.clear();
+  lifts.clear();
+  groups.clear();
+  inventory.clear();
+  workers.clear();
+  table.reset(options.tableBits ? new TranspositionTable(options.tableBits) : nullptr);
+  solution.clear();
+  pending = 0;
+  nodes = 0;
+  stop = false;
+  aborted = false;
+  solved = false;
+
+  if (options.mode == Mode::PRUNED)
+    preparePruned(probe);
+  else
+    prepareExhaustive(probe);
+
+  const u32 threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+  for (u32 i = 0; i < threads; ++i)
+  {
+    workers.emplace_back(new Worker());
+    Worker& worker = *workers.back();
+
+    worker.simulator.setBitboard(options.bitboard);
+    worker.simulator.load(level);
+    for (const Variable& variable : variables)
+      worker.positions.push_back(variable.origin);
+    worker.slots = inventory;
+    worker.changed.assign(probe.field().width()*probe.field().height(), false);
+  }
+
+  push(*workers[0], Task());
+
+  std::vector<std::thread> pool;
+  for (u32 i = 1; i < threads; ++i)
+    pool.emplace_back(&Solver::run, this, i);
+
+  run(0);
+
+  for (std::thread& thread : pool)
+    thread.join();
+
+  return solved;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "simulator.h"
+#include "transposition.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/* search of the placements and rotations of the pieces a level lets the player move,
+   the top of the search tree is split into tasks which idle threads steal from each other */
+class Solver
+{
+public:
+  enum class Mode
+  {
+    /* every piece tries every empty tile and rotation */
+    EXHAUSTIVE,
+    /* pieces only go on lit tiles, identical pieces are interchangeable and equivalent rotations are tried once */
+    PRUNED
+  };
+
+  struct Options
+  {
+    Mode mode = Mode::EXHAUSTIVE;
+    /* 0 uses every hardware thread */
+    u32 threads = 0;
+    /* nodes above this depth are split into tasks instead of being searched in place */
+    u32 splitDepth = 2;
+    /* give up after this many nodes, 0 never gives up */
+    u64 maxNodes = 0;
+    /* log2 of the entries of the transposition table shared by the threads, 0 disables it */
+    u32 tableBits = 0;
+    /* lasers are traced by BitboardTracer instead of source by source */
+    bool bitboard = false;
+    /* pruned search, the decisions of a node are searched from the one getting closest to the goals */
+    bool guided = false;
+  };
+
+private:
+  /* a piece the exhaustive search can move or rotate, identified by where it sits in the level */
+  struct Variable
+  {
+    Position origin;
+    bool movable;
+    bool rotatable;
+  };
+
+  /* identical pieces the pruned search takes from the inventory as a multiset */
+  struct Group
+  {
+    PieceType type;
+    LaserColor color;
+    bool rotatable;
+    /* only meaningful for pieces which can't be rotated */
+    Direction orientation;
+  };
+
+  using Task = std::vector<Placement>;
+
+  struct Worker
+  {
+    Simulator simulator;
+    std::vector<Placement> path;
+    std::vector<Direction> orientations;
+
+    /* exhaustive search, current position of each variable */
+    std::vector<Position> positions;
+
+    /* pruned search, inventory slots left in each group and field tiles already changed */
+    std::vector<std::vector<Position>> slots;
+    std::vector<bool> changed;
+    /* tiles lit at each node of the path and tile of each decision, so that independent decisions are taken in one order only */
+    std::vector<u64> lit;
+    std::vector<s32> keys;
+    u64 changedKey;
+
+    std::mutex lock;
+    std::deque<Task> tasks;
+
+    Worker() : simulator(), changedKey(0) { }
+  };
+
+  LevelRef level;
+  Options options;
+  std::vector<Variable> variables;
+  std::vector<Position> lifts;
+  std::vector<Group> groups;
+  std::vector<std::vector<Position>> inventory;
+  size_t litWords;
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::unique_ptr<TranspositionTable> table;
+
+  std::atomic<size_t> pending;
+  std::atomic<u64> nodes;
+  std::atomic<bool> stop;
+  std::atomic<bool> aborted;
+
+  std::mutex solutionLock;
+  std::vector<Placement> solution;
+  bool solved;
+
+  bool isSolved(const Simulator& simulator) const;
+  s32 score(const Simulator& simulator) const;
+  u64 stateKey(const Worker& worker) const;
+  bool visit(Worker& worker);
+
+  void push(Worker& worker, Task task);
+  bool pop(Worker& worker, Task& task);
+  bool steal(size_t thief, Task& task);
+
+  bool apply(Worker& worker, size_t variable, Position to, Direction orientation);
+  void undo(Worker& worker);
+  template<typename F> void forEachOption(const Worker& worker, size_t variable, F f);
+  void search(Worker& worker, size_t depth);
+
+  size_t groupOf(const Piece* piece) const;
+  void mark(Worker& worker);
+  bool isLit(const Worker& worker, size_t depth, u32 index) const;
+  bool applyPruned(Worker& worker, const Placement& placement);
+  void undoPruned(Worker& worker);
+  template<typename F> void forEachDecision(const Worker& worker, F f);
+  void searchPruned(Worker& worker);
+
+  void prepareExhaustive(const Simulator& simulator);
+  void preparePruned(const Simulator& simulator);
+
+  void run(size_t index);
+  void execute(Worker& worker, const Task& task);
+
+public:
+  Solver(const LevelRef& level) : Solver(level, Options()) { }
+  Solver(const LevelRef& level, Options options);
+
+  /* false if no solution exists, or if the level can't be loaded or maxNodes was reached */
+  bool solve();
+
+  bool isAborted() const { return aborted; }
+  u64 searchedNodes() const { return nodes; }
+  /* moves applied in order from the initial state of the level */
+  const std::vector<Placement>& placements() const { return solution; }
+};
@@ -0,0 +1,253 @@
+#include "transitions.h"
+
+#include "level.h"
+
+#include <cstring>
+
+/* pieces whose behavior only depends on the beam entering them, teleporters look at the rest of the field */
+static const PieceType tabulatedPieces[] = {
+  PIECE_WALL, PIECE_SOURCE,
+  PIECE_MIRROR, PIECE_DOUBLE_MIRROR, PIECE_DOUBLE_PASS_MIRROR, PIECE_SKEW_MIRROR, PIECE_DOUBLE_SKEW_MIRROR, PIECE_DOUBLE_SPLITTER_MIRROR,
+  PIECE_REFRACTOR, PIECE_SPLITTER, PIECE_ANGLED_SPLITTER, PIECE_THREE_WAY_SPLITTER, PIECE_STAR_SPLITTER, PIECE_PRISM, PIECE_FLIPPED_PRISM,
+  PIECE_GLASS, PIECE_FILTER, PIECE_POLARIZER, PIECE_TUNNEL,
+  PIECE_RIGHT_BENDER, PIECE_LEFT_BENDER, PIECE_RIGHT_TWISTER, PIECE_LEFT_TWISTER,
+  PIECE_SELECTOR, PIECE_SPLICER, PIECE_COLOR_SHIFTER, PIECE_COLOR_INVERTER,
+  PIECE_TNT, PIECE_STRICT_GOAL, PIECE_MINE, PIECE_SLIME,
+  PIECE_ROUND_FILTER, PIECE_CROSS_COLOR_INVERTER
+};
+
+static constexpr size_t VARIANTS = 8 * 8 * 64;
+
+/* beams leaving a piece merged by direction, a beam without color still counts since goals and TNT see it */
+struct Outgoing
+{
+  u8 present;
+  std::array<u8, 8> colors;
+  
+  Outgoing() : present(0), colors() { }
+  
+  void add(u8 beam)
+  {
+    present |= 1 << Transition::direction(beam);
+    colors[Transition::direction(beam)] |= Transition::color(beam);
+  }
+  
+  void add(const Transition& transition)
+  {
+    for (u8 i = 0; i < transition.count; ++i)
+      add(transition.beams[i]);
+    if (transition.continues())
+      add(transition.next);
+  }
+  
+  bool operator==(const Outgoing& o) const { return present == o.present && colors == o.colors; }
+};
+
+/* whether entering with color does what entering with each of its channels does, the entry half is only lit
+   by the channels which aren't blocked */
+template<typename F> static bool separable(const Transition& whole, F channel, u32 color)
+{
+  Outgoing merged, outgoing;
+  u8 flags = 0, passing = 0;
+  
+  for (u32 c = 1; c < 8; c <<= 1)
+  {
+    if (!(color & c))
+      continue;
+    
+    const Transition& part = channel(c);
+    
+    if (part.blocked())
+      continue;
+    
+    passing |= c;
+    flags |= part.flags & (Transition::GOAL | Transition::FAIL);
+    merged.add(part);
+  }
+  
+  if (whole.blocked())
+    return passing == 0;
+  
+  outgoing.add(whole);
+  return passing == color && flags == (whole.flags & (Transition::GOAL | Transition::FAIL)) && outgoing == merged;
+}
+
+bool Transition::operator==(const Transition& o) const
+{
+  return flags == o.flags && next == o.next && count == o.count && std::memcmp(beams, o.beams, count) == 0;
+}
+
+Transition TransitionTable::compute(Field& field, const Piece& piece, Direction direction, LaserColor color)
+{
+  Transition transition = { 0, 0, 0, { 0, 0, 0, 0 } };
+  Laser laser = Laser(Position(1, 1), direction, color);
+  
+  if (piece.blocksLaser(laser))
+  {
+    transition.flags = Transition::BLOCKED;
+    return transition;
+  }
+  
+  // goals keep state, the field collects what they receive
+  if (piece.isGoal())
+  {
+    transition.flags = Transition::GOAL | Transition::CONTINUES;
+    transition.next = Transition::beam(direction, color);
+    return transition;
+  }
+  
+  field.lasers.clear();
+  field.trace->failed = false;
+  
+  piece.receiveLaser(&field, laser);
+  
+  if (field.trace->failed)
+    transition.flags |= Transition::FAIL;
+  
+  assert(field.lasers.size() <= sizeof(transition.beams));
+  
+  for (const Laser& beam : field.lasers)
+    transition.beams[transition.count++] = Transition::beam(beam.direction, beam.color);
+  
+  if (field.isInside(laser.position))
+  {
+    assert(laser.position.x == 1 && laser.position.y == 1);
+    transition.flags |= Transition::CONTINUES;
+    transition.next = Transition::beam(laser.direction, laser.color);
+  }
+  
+  return transition;
+}
+
+void TransitionTable::computeAll(Field& field, PieceType type, std::vector<Transition>& variants)
+{
+  Piece piece = Piece(type);
+  
+  variants.resize(VARIANTS);
+  
+  for (u32 r = 0; r < 8; ++r)
+    for (u32 c = 0; c < 8; ++c)
+    {
+      piece.setOrientation(static_cast<Direction>(r));
+      piece.setColor(static_cast<LaserColor>(c));
+      
+      for (u32 d = 0; d < 8; ++d)
+        for (u32 i = 0; i < 8; ++i)
+          variants[(((r << 3) | c) << 6) | (d << 3) | i] = compute(field, piece, static_cast<Direction>(d), static_cast<LaserColor>(i));
+    }
+}
+
+TransitionTable::TransitionTable()
+{
+  layouts.fill({ NO_ROW, 0, 0 });
+  
+  Field field(3, 3, 0, 0);
+  BeamTrace trace(0, 9);
+  field.trace = &trace;
+  
+  std::vector<Transition> variants;
+  
+  auto sameRows = [&variants] (u32 r1, u32 c1, u32 r2, u32 c2) {
+    return std::equal(&variants[((r1 << 3) | c1) << 6], &variants[((r1 << 3) | c1) << 6] + 64, &variants[((r2 << 3) | c2) << 6]);
+  };
+  
+  for (PieceType type : tabulatedPieces)
+  {
+    computeAll(field, type, variants);
+    
+    bool byRotation = false, byColor = false;
+    
+    for (u32 r = 0; r < 8; ++r)
+      for (u32 c = 0; c < 8; ++c)
+      {
+        byRotation |= !sameRows(r, c, 0, c);
+        byColor |= !sameRows(r, c, r, 0);
+      }
+    
+    Layout& layout = layouts[type];
+    layout.base = static_cast<u16>(transitions.size() >> 6);
+    layout.colorStride = byColor ? 1 : 0;
+    layout.rotationStride = byRotation ? (byColor ? 8 : 1) : 0;
+    
+    for (u32 r = 0; r < (byRotation ? 8 : 1); ++r)
+      for (u32 c = 0; c < (byColor ? 8 : 1); ++c)
+        transitions.insert(transitions.end(), &variants[((r << 3) | c) << 6], &variants[((r << 3) | c) << 6] + 64);
+  }
+  
+  mixing.resize(transitions.size() >> 6, false);
+  
+  // only colors with several channels can behave differently from their channels
+  for (u16 row = 0; row < mixing.size(); ++row)
+    for (u32 d = 0; d < 8; ++d)
+      for (u32 c : { LaserColor::YELLOW, LaserColor::MAGENTA, LaserColor::CYAN, LaserColor::WHITE })
+        mixing[row] = mixing[row] || !separable(at(row, static_cast<Direction>(d), static_cast<LaserColor>(c)),
+          [this, row, d] (u32 channel) -> const Transition& { return at(row, static_cast<Direction>(d), static_cast<LaserColor>(channel)); }, c);
+  
+  for (u32 t = 0; t < PIECES_COUNT; ++t)
+    for (u32 c = 0; c < 8; ++c)
+    {
+      std::array<u8, 8>& representative = representatives[t*8 + c];
+      
+      for (u32 r = 0; r < 8; ++r)
+      {
+        representative[r] = r;
+        
+        // sources emit along their orientation, which isn't part of the transitions
+        if (layouts[t].base == NO_ROW || t == PIECE_SOURCE)
+          continue;
+        
+        const u16 row = this->row(static_cast<PieceType>(t), static_cast<Direction>(r), static_cast<LaserColor>(c));
+        
+        for (u32 o = 0; o < r; ++o)
+        {
+          const u16 other = this->row(static_cast<PieceType>(t), static_cast<Direction>(o), static_cast<LaserColor>(c));
+          
+          if (std::equal(&transitions[row << 6], &transitions[row << 6] + 64, &transitions[other << 6]))
+          {
+            representative[r] = o;
+            break;
+          }
+        }
+      }
+    }
+  
+  field.trace = nullptr;
+}
+
+const TransitionTable& TransitionTable::instance()
+{
+  static const TransitionTable table;
+#ifndef NDEBUG
+  static const bool verified = table.verify();
+  assert(verified);
+#endif
+  return table;
+}
+
+bool TransitionTable::verify() const
+{
+  Field field(3, 3, 0, 0);
+  BeamTrace trace(0, 9);
+  field.trace = &trace;
+  
+  std::vector<Transition> variants;
+  bool valid = true;
+  
+  for (PieceType type : tabulatedPieces)
+  {
+    computeAll(field, type, variants);
+    
+    for (u32 r = 0; r < 8; ++r)
+      for (u32 c = 0; c < 8; ++c)
+        for (u32 d = 0; d < 8; ++d)
+          for (u32 i = 0; i < 8; ++i)
+          {
+            const Transition& expected = variants[(((r << 3) | c) << 6) | (d << 3) | i];
+            const u16 row = this->row(type, static_cast<Direction>(r), static_cast<LaserColor>(c));
+            valid &= at(row, static_cast<Direction>(d), static_cast<LaserColor>(i)) == expected;
+          }
+  }
+  
+  field.trace = nullptr;
+  return valid;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "common/common.h"
+
+#include <array>
+#include <vector>
+
+class Field;
+class Piece;
+
+/* outcome of a beam entering a piece, beams are packed as direction | color << 3 */
+struct Transition
+{
+  enum Flags : u8
+  {
+    BLOCKED   = 0x01,
+    CONTINUES = 0x02,
+    GOAL      = 0x04,
+    FAIL      = 0x08
+  };
+
+  u8 flags;
+  u8 next;
+  u8 count;
+  u8 beams[4];
+
+  bool blocked() const { return flags & BLOCKED; }
+  bool continues() const { return flags & CONTINUES; }
+
+  static Direction direction(u8 beam) { return static_cast<Direction>(beam & 0x07); }
+  static LaserColor color(u8 beam) { return static_cast<LaserColor>(beam >> 3); }
+  static u8 beam(Direction direction, LaserColor color) { return direction | (color << 3); }
+
+  bool operator==(const Transition& o) const;
+};
+
+/* behavior of every local piece for each (rotation, piece color, incoming direction, incoming color),
+   computed once from PieceMechanics so that tracing doesn't go through virtual calls and std::function.
+   Rotations and colors which don't change the behavior of a piece share the same rows. */
+class TransitionTable
+{
+public:
+  static constexpr u16 NO_ROW = 0xFFFF;
+
+private:
+  struct Layout
+  {
+    u16 base;
+    u8 rotationStride;
+    u8 colorStride;
+  };
+
+  std::array<Layout, PIECES_COUNT> layouts;
+  std::vector<Transition> transitions;
+  /* smallest rotation behaving like each rotation of a (type, color) */
+  std::array<std::array<u8, 8>, PIECES_COUNT * 8> representatives;
+  /* rows where a beam of several channels doesn't do what its channels would do one by one */
+  std::vector<bool> mixing;
+
+  TransitionTable();
+
+  static Transition compute(Field& field, const Piece& piece, Direction direction, LaserColor color);
+  static void computeAll(Field& field, PieceType type, std::vector<Transition>& variants);
+
+public:
+  static const TransitionTable& instance();
+
+  u16 row(PieceType type, Direction rotation, LaserColor color) const
+  {
+    const Layout& layout = layouts[type];
+    return layout.base == NO_ROW ? NO_ROW : layout.base + rotation*layout.rotationStride + color*layout.colorStride;
+  }
+
+  const Transition& at(u16 row, Direction direction, LaserColor color) const { return transitions[(row << 6) | (direction << 3) | color]; }
+
+  /* a beam entering a row which doesn't mix channels has the lasers, beams, goal hits and failures of its channels traced
+     on their own merged together, untabulated pieces never mix them */
+  bool mixes(u16 row) const { return row < mixing.size() && mixing[row]; }
+
+  /* rotations of a piece are equivalent when every incoming beam has the same outcome, untabulated pieces have no equivalent rotations */
+  Direction representative(PieceType type, Direction rotation, LaserColor color) const { return static_cast<Direction>(representatives[type*8 + color][rotation]); }
+
+  bool verify() const;
+};
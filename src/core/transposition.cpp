@@ -0,0 +1,47 @@
+#include "transposition.h"
+
+#include <algorithm>
+
+TranspositionTable::TranspositionTable(u32 bits) : entries(new std::atomic<u64>[size_t(1) << std::max(bits, 2u)]),
+  mask((u64(1) << std::max(bits, 2u)) - 1), replaced(0)
+{
+  clear();
+}
+
+void TranspositionTable::clear()
+{
+  for (u64 i = 0; i <= mask; ++i)
+    entries[i].store(0, std::memory_order_relaxed);
+  replaced = 0;
+}
+
+bool TranspositionTable::insert(u64 hash, u32 depth)
+{
+  // 0 marks an empty entry so it's never a valid key
+  const u64 key = (hash & ~DEPTH_MASK) ? (hash & ~DEPTH_MASK) : DEPTH_MASK + 1;
+  const u64 entry = key | std::min<u64>(depth, DEPTH_MASK);
+  std::atomic<u64>* bucket = &entries[hash & mask & ~u64(BUCKET - 1)];
+
+  std::atomic<u64>* victim = nullptr;
+  u64 expected = 0;
+
+  for (u32 i = 0; i < BUCKET; ++i)
+  {
+    const u64 current = bucket[i].load(std::memory_order_relaxed);
+
+    if ((current & ~DEPTH_MASK) == key)
+      return false;
+    else if (!victim || (expected && (current == 0 || (current & DEPTH_MASK) > (expected & DEPTH_MASK))))
+    {
+      victim = &bucket[i];
+      expected = current;
+    }
+  }
+
+  /* losing the race against another thread only means that a state may be explored twice,
+     which costs time but never correctness */
+  if (victim->compare_exchange_strong(expected, entry, std::memory_order_relaxed) && expected)
+    ++replaced;
+
+  return true;
+}
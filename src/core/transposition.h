@@ -0,0 +1,31 @@
+#pragma once
+
+#include "common/common.h"
+
+#include <atomic>
+#include <memory>
+
+/* fixed size table of the search states already reached, shared without locks by every solver thread.
+   Each entry packs the upper bits of a 64-bit state hash with the depth it was reached at, a bucket
+   holds a few entries and when it's full the deepest one is replaced since it covers the least work */
+class TranspositionTable
+{
+private:
+  static constexpr u32 BUCKET = 4;
+  static constexpr u64 DEPTH_MASK = 0x3F;
+
+  std::unique_ptr<std::atomic<u64>[]> entries;
+  u64 mask;
+  std::atomic<u64> replaced;
+
+public:
+  /* 2^bits entries of 8 bytes */
+  TranspositionTable(u32 bits);
+
+  /* true if the state wasn't in the table yet, which means the caller is in charge of exploring it */
+  bool insert(u64 hash, u32 depth);
+  void clear();
+
+  size_t capacity() const { return mask + 1; }
+  u64 replacements() const { return replaced; }
+};
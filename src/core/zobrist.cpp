@@ -0,0 +1,10 @@
+#include "zobrist.h"
+
+Zobrist::Zobrist(size_t tiles) : keys(tiles*STRIDE)
+{
+  // splitmix64 with a fixed seed
+  u64 state = 0x4C617A657273ULL;
+
+  for (u64& key : keys)
+    key = mix(state += 0x9E3779B97F4A7C15ULL);
+}
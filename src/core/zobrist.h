@@ -0,0 +1,36 @@
+#pragma once
+
+#include "pieces.h"
+
+#include <vector>
+
+/* random keys for each (tile, type), (tile, rotation) and (tile, color), a configuration is hashed by
+   xoring the keys of its pieces so that changing a single tile updates the hash in constant time */
+class Zobrist
+{
+private:
+  static constexpr size_t STRIDE = PIECES_COUNT + 8 + 8;
+
+  std::vector<u64> keys;
+
+public:
+  /* keys only depend on the number of tiles so equal configurations hash the same in every Field */
+  Zobrist(size_t tiles);
+
+  /* splitmix64 finalizer, also used to salt hashes with state which isn't part of the pieces */
+  static u64 mix(u64 z)
+  {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  u64 key(size_t tile, const Piece* piece) const
+  {
+    if (!piece)
+      return 0;
+
+    const u64* base = &keys[tile*STRIDE];
+    return base[piece->type()] ^ base[PIECES_COUNT + piece->rotation()] ^ base[PIECES_COUNT + 8 + piece->color()];
+  }
+};
@@ -9,14 +9,20 @@
 #include "aargon.h"
 
 #include "files.h"
+#include "pack_file.h"
 
-#include <fstream>
+#include <atomic>
+#include <cstdio>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <iostream>
 
 #include <cassert>
+#include <cstring>
+
+#include <sys/stat.h>
 
 #define ASSERT(condition, message) \
 do { \
@@ -187,50 +193,81 @@ bool canHaveColor(PieceType type)
   }
 }
 
+/* a line of a level file, pointing into the contents of the file so that tokenizing doesn't copy them */
+struct LineRef
+{
+  const char* data;
+  size_t length;
+
+  char operator[](size_t index) const { return data[index]; }
+  bool startsWith(const string& prefix) const { return length >= prefix.length() && prefix.compare(0, prefix.length(), data, prefix.length()) == 0; }
+};
+
+static bool readFile(const string& filename, string& content)
+{
+  FILE* in = fopen(filename.c_str(), "rb");
+
+  if (!in)
+    return false;
+
+  fseek(in, 0, SEEK_END);
+  const long size = ftell(in);
+  fseek(in, 0, SEEK_SET);
+
+  content.resize(size > 0 ? size : 0);
+  const size_t read = size > 0 ? fread(&content[0], 1, size, in) : 0;
+  fclose(in);
+
+  return read == content.size();
+}
+
 LevelSpec Aargon::parseLevel(const string& filename)
 {
-  ifstream in(filename);
-  
-  cout << "parsing " << filename << endl;
+  string content;
+  const bool found = readFile(filename, content);
 
-  assert(!in.fail());
+  assert(found);
+  (void)found;
   
-  string line;
-  vector<string> lines;
+  vector<LineRef> lines;
+  lines.reserve(16);
   
-  const std::string content = std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  const char* data = content.data();
   const size_t length = content.length();
+  size_t start = 0;
 
   for (size_t i = 0; i < length; ++i)
   {
-    const char c = content[i];
+    const char c = data[i];
 
     if (c == '\r' || c == '\n')
     {
+      if (i > start)
+        lines.push_back({ data + start, i - start });
+
       if (c == '\r')
       {
-        assert(i < length - 1 && content[i + 1] == '\n');
+        assert(i < length - 1 && data[i + 1] == '\n');
         ++i;
       }
 
-      if (!line.empty())
-        lines.push_back(line);
-      line.clear();
+      start = i + 1;
     }
-    else
-      line += c;
   }
 
+  if (length > start)
+    lines.push_back({ data + start, length - start });
+
   assert(lines.size() == 16);
   
   for (int i = 0; i < 13; ++i)
-    assert(lines[i].length() == 20*4);
+    assert(lines[i].length == 20*4);
   
-  assert(lines[13].compare(0, NAME_PREFIX.length(), NAME_PREFIX) == 0);
-  assert(lines[14].compare(0, SCRIPT_PREFIX.length(), SCRIPT_PREFIX) == 0);
-  assert(lines[15].compare(0, COPYRIGHT_PREFIX.length(), COPYRIGHT_PREFIX) == 0);
+  assert(lines[13].startsWith(NAME_PREFIX));
+  assert(lines[14].startsWith(SCRIPT_PREFIX));
+  assert(lines[15].startsWith(COPYRIGHT_PREFIX));
   
-  string tmpName = string(lines[13].substr(NAME_PREFIX.length(), lines[13].length() - NAME_PREFIX.length() - 1));
+  string tmpName = string(lines[13].data + NAME_PREFIX.length(), lines[13].length - NAME_PREFIX.length() - 1);
   stringstream nameBuffer;
   
   for (int i = 0; i < tmpName.length(); ++i)
@@ -253,7 +290,7 @@ LevelSpec Aargon::parseLevel(const string& filename)
   
   for (int i = 1; i < 12; ++i)
   {
-    const char *line = lines[i].c_str();
+    const char *line = lines[i].data;
     char *data;
     
     for (int j = 0; j < 20; ++j)
@@ -337,7 +374,7 @@ struct AargonPack
   int skillNumber;
 };
 
-std::vector<LevelPack> Aargon::parseLevels()
+static vector<AargonPack> aargonPacks()
 {
   /*string base = "/Users/jack/Desktop/Twilight/Aargon Deluxe/Level Packs/";
   string packs[] = {"Tutorial", "Deluxe", "Classic", "Smooth Sailing", "Demo Level Set", "Level Pack 1"};
@@ -386,34 +423,292 @@ std::vector<LevelPack> Aargon::parseLevels()
   apacks.push_back({ "Aargon Space Station (Engineering)", "Twilight Games", "aargon-space-station-02", "Level Pack 1", 3 });
   apacks.push_back({ "Aargon Space Station (Intelligence)", "Twilight Games", "aargon-space-station-03", "Level Pack 1", 4 });*/
   
-  std::vector<LevelPack> packs;
-  size_t levelCount = 0;
+  return apacks;
+}
+
+static const string AARGON_BASE = "packs/aargon/";// "/Users/jack/Documents/Dev/c++/lazers/data/aargon/";
+static const string AARGON_CACHE = AARGON_BASE + "levels.cache";
+
+/* 30 level files for each pack, in pack order */
+static vector<string> levelPaths(const vector<AargonPack>& apacks)
+{
+  vector<string> paths;
   
   for (const AargonPack &apack : apacks)
   {
-    LevelPack npack = LevelPack(apack.name, apack.author, apack.filename);
-
     for (int i = 1; i <= 30; ++i)
     {
-      string base = "packs/aargon/";// "/Users/jack/Documents/Dev/c++/lazers/data/aargon/";
       stringstream ss;
-      ss << base << apack.folderName << "/" << "Levels/SKILL";
+      ss << AARGON_BASE << apack.folderName << "/" << "Levels/SKILL";
       ss << apack.skillNumber << "/";
       ss << "Level_0";
       if (i < 10) ss << '0';
       ss << i << ".map";
       
-      const std::string path = ss.str();
-      
-      npack.addLevel(parseLevel(path));
+      paths.push_back(ss.str());
     }
+  }
+  
+  return paths;
+}
+
+std::vector<LevelPack> Aargon::parseLevels()
+{
+  const vector<AargonPack> apacks = aargonPacks();
+  const vector<string> paths = levelPaths(apacks);
+  
+  /* files are parsed concurrently, each level is stored at the index of its file so that the packs are
+     assembled in the same order whatever thread parsed them */
+  vector<LevelSpec> levels(paths.size(), LevelSpec(""));
+  atomic<size_t> next(0);
+  
+  auto work = [&] () {
+    for (size_t i = next++; i < paths.size(); i = next++)
+      levels[i] = parseLevel(paths[i]);
+  };
+  
+  const size_t threads = std::min<size_t>(std::max(1u, thread::hardware_concurrency()), paths.size());
+  vector<thread> pool;
+  
+  for (size_t i = 1; i < threads; ++i)
+    pool.emplace_back(work);
+  work();
+  for (thread& t : pool)
+    t.join();
+  
+  std::vector<LevelPack> packs;
+  size_t levelCount = 0;
+  
+  for (const AargonPack &apack : apacks)
+  {
+    const vector<LevelSpec> plevels(levels.begin() + levelCount, levels.begin() + levelCount + 30);
+    packs.push_back(LevelPack(apack.name, apack.author, apack.filename, plevels));
 
     levelCount += 30;
-    
-    packs.push_back(npack);
   }
 
   printf("Parsed %zu Aargon levels.\n", levelCount);
   
   return packs;
 }
+
+/* the cache holds every parsed level so that the .map files are only parsed again when one of them changes:
+   "LZAC", version, key of the sources, then for each pack its strings and its levels with their pieces encoded
+   as in a PackFile, so that a cache written by another build is read the same and bad pieces are rejected */
+static const u32 CACHE_VERSION = 2;
+
+static u64 mixKey(u64 key, u64 value)
+{
+  key ^= value + 0x9e3779b97f4a7c15ULL + (key << 6) + (key >> 2);
+  return key;
+}
+
+/* size and modification time of every source file, a missing file never matches a cache */
+static bool sourceKey(const vector<string>& paths, u64& key)
+{
+  key = mixKey(CACHE_VERSION, paths.size());
+  
+  for (const string& path : paths)
+  {
+    struct stat info;
+    
+    if (stat(path.c_str(), &info))
+      return false;
+    
+    key = mixKey(key, static_cast<u64>(info.st_size));
+    key = mixKey(key, static_cast<u64>(info.st_mtime));
+  }
+  
+  return true;
+}
+
+class CacheReader
+{
+private:
+  const string& data;
+  size_t offset;
+  
+public:
+  CacheReader(const string& data) : data(data), offset(0) { }
+  
+  bool read(void* dest, size_t length)
+  {
+    if (data.size() - offset < length)
+      return false;
+    
+    memcpy(dest, data.data() + offset, length);
+    offset += length;
+    return true;
+  }
+  
+  template<typename T> bool read(T& value) { return read(&value, sizeof(T)); }
+  
+  bool read(string& value)
+  {
+    u8 length;
+    
+    if (!read(length))
+      return false;
+    
+    value.resize(length);
+    return read(&value[0], length);
+  }
+  
+  /* bytes left in place, valid as long as the data */
+  const char* view(size_t length)
+  {
+    if (data.size() - offset < length)
+      return nullptr;
+    
+    offset += length;
+    return data.data() + offset - length;
+  }
+  
+  bool done() const { return offset == data.size(); }
+};
+
+static bool readCache(u64 key, vector<LevelPack>& packs)
+{
+  string data;
+  
+  if (!readFile(AARGON_CACHE, data))
+    return false;
+  
+  CacheReader reader(data);
+  char magic[4];
+  u32 version, packCount;
+  u64 cacheKey;
+  
+  if (!reader.read(magic, sizeof(magic)) || memcmp(magic, "LZAC", sizeof(magic)) ||
+      !reader.read(version) || version != CACHE_VERSION ||
+      !reader.read(cacheKey) || cacheKey != key ||
+      !reader.read(packCount))
+    return false;
+  
+  for (u32 p = 0; p < packCount; ++p)
+  {
+    string name, author, path;
+    u32 levelCount;
+    
+    if (!reader.read(name) || !reader.read(author) || !reader.read(path) || !reader.read(levelCount))
+      return false;
+    
+    vector<LevelSpec> levels;
+    levels.reserve(levelCount);
+    
+    for (u32 i = 0; i < levelCount; ++i)
+    {
+      u8 nameLength;
+      u16 pieceCount;
+      const char* levelName;
+      const char* pieces;
+      
+      if (!reader.read(nameLength) || !(levelName = reader.view(nameLength)) ||
+          !reader.read(pieceCount) || !(pieces = reader.view(pieceCount * PackFile::PIECE_SIZE)))
+        return false;
+      
+      LevelSpec level = LevelSpec(string_view(levelName, nameLength));
+      PieceInfo info(PIECE_WALL);
+      
+      for (u16 j = 0; j < pieceCount; ++j)
+      {
+        if (!PackFile::readPiece(reinterpret_cast<const u8*>(pieces) + j * PackFile::PIECE_SIZE, info))
+          return false;
+        
+        level.add(info);
+      }
+      
+      levels.push_back(std::move(level));
+    }
+    
+    packs.push_back(LevelPack(name, author, path, levels));
+  }
+  
+  return reader.done();
+}
+
+static void writeString(string& data, string_view value)
+{
+  data += static_cast<char>(std::min<size_t>(value.length(), 255));
+  data.append(value, 0, 255);
+}
+
+template<typename T> static void writeValue(string& data, T value)
+{
+  data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/* written to a temporary file first so that an interrupted write never leaves a cache which looks valid,
+   failing to write it only means the levels are parsed again next time */
+static void writeCache(u64 key, const vector<LevelPack>& packs)
+{
+  string data = "LZAC";
+  writeValue(data, CACHE_VERSION);
+  writeValue(data, key);
+  writeValue(data, static_cast<u32>(packs.size()));
+  
+  for (const LevelPack& pack : packs)
+  {
+    writeString(data, pack.name());
+    writeString(data, pack.author());
+    writeString(data, pack.path());
+    writeValue(data, static_cast<u32>(pack.count()));
+    
+    for (u32 i = 0; i < pack.count(); ++i)
+    {
+      const LevelRef level = pack.at(i);
+      
+      writeString(data, level->name());
+      writeValue(data, static_cast<u16>(level->count()));
+      
+      for (size_t j = 0; j < level->count(); ++j)
+      {
+        u8 piece[PackFile::PIECE_SIZE];
+        PackFile::writePiece(level->at(j), piece);
+        data.append(reinterpret_cast<const char*>(piece), sizeof(piece));
+      }
+    }
+  }
+  
+  const string temp = AARGON_CACHE + ".tmp";
+  FILE* out = fopen(temp.c_str(), "wb");
+  
+  if (!out)
+    return;
+  
+  const bool written = fwrite(data.data(), 1, data.size(), out) == data.size();
+  
+  if (fclose(out) || !written)
+  {
+    remove(temp.c_str());
+    return;
+  }
+  
+#ifdef _WIN32
+  // rename doesn't replace an existing file there, a stale cache would be kept forever
+  remove(AARGON_CACHE.c_str());
+#endif
+  
+  if (rename(temp.c_str(), AARGON_CACHE.c_str()))
+    remove(temp.c_str());
+}
+
+std::vector<LevelPack> Aargon::loadLevels()
+{
+  const vector<string> paths = levelPaths(aargonPacks());
+  
+  u64 key;
+  const bool keyed = sourceKey(paths, key);
+  
+  std::vector<LevelPack> packs;
+  
+  if (keyed && readCache(key, packs))
+    return packs;
+  
+  packs = parseLevels();
+  
+  if (keyed)
+    writeCache(key, packs);
+  
+  return packs;
+}
@@ -21,4 +21,6 @@ class Aargon
 public:
   static LevelSpec parseLevel(const std::string& name);
   static std::vector<LevelPack> parseLevels();
+  /* parsed levels from the binary cache, which is rebuilt when a level file changes */
+  static std::vector<LevelPack> loadLevels();
 };
\ No newline at end of file
@@ -9,6 +9,7 @@
 #include "files.h"
 
 #include "core/level.h"
+#include "files/pack_file.h"
 
 #ifdef _WIN32
 #include "platforms/windows/dirent.h"
@@ -19,102 +20,313 @@
 #include <algorithm>
 #include <cstring>
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
-const u8 base64map[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+/* base64 without padding, a trailing group of 1 or 2 bytes is written as 2 or 3 characters */
+
+static const char base64map[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-u8 value(u8 v)
+/* characters outside of the alphabet decode as '/' */
+struct Base64Values
 {
-  if (v >= 'A' && v <= 'Z')
-    return v - 'A';
-  else if (v >= 'a' && v <= 'z')
-    return v - 'a' + 26;
-  else if (v >= '0' && v <= '9')
-    return v - '0' + 26 + 26;
-  else if (v == '+')
-    return 26+26+10;
-  else
-    return 26+26+10+1;
+  u8 values[256];
+
+  Base64Values()
+  {
+    memset(values, 63, sizeof(values));
+    for (u8 i = 0; i < 64; ++i)
+      values[static_cast<u8>(base64map[i])] = i;
+  }
+};
+
+static const Base64Values base64values;
+
+static void encodeScalar(const u8 *input, size_t length, char *output)
+{
+  size_t i = 0;
+
+  for (; i + 3 <= length; i += 3, output += 4)
+  {
+    const u32 v = (input[i] << 16) | (input[i+1] << 8) | input[i+2];
+    output[0] = base64map[(v >> 18) & 0x3F];
+    output[1] = base64map[(v >> 12) & 0x3F];
+    output[2] = base64map[(v >> 6) & 0x3F];
+    output[3] = base64map[v & 0x3F];
+  }
+
+  if (i < length)
+  {
+    const u32 v = (input[i] << 16) | (i + 1 < length ? input[i+1] << 8 : 0);
+    output[0] = base64map[(v >> 18) & 0x3F];
+    output[1] = base64map[(v >> 12) & 0x3F];
+    if (i + 1 < length)
+      output[2] = base64map[(v >> 6) & 0x3F];
+  }
 }
 
-void Files::encode(const u8 *input, size_t length, char **outputPtr, size_t *outputLength)
+static size_t decodeScalar(const char *input, size_t length, u8 *output)
 {
-  size_t steps = length/3;
-  *outputLength = steps*4;
-  size_t extraBytes = length%3;
-  
-  if (extraBytes != 0)
+  const u8 *values = base64values.values;
+  const u8 *in = reinterpret_cast<const u8*>(input);
+  u8 *start = output;
+  size_t i = 0;
+
+  for (; i + 4 <= length; i += 4, output += 3)
   {
-    *outputLength += extraBytes + 1;
-    ++steps;
+    const u32 v = (values[in[i]] << 18) | (values[in[i+1]] << 12) | (values[in[i+2]] << 6) | values[in[i+3]];
+    output[0] = v >> 16;
+    output[1] = v >> 8;
+    output[2] = v;
   }
-  
-  char *output = new char [*outputLength];
-  *outputPtr = output;
-  
-  for (size_t i = 0; i < steps; ++i)
+
+  const size_t extra = length - i;
+
+  if (extra >= 2)
   {
-    const u8 *inputPiece;
-    
-    if (i == steps - 1 && extraBytes != 0)
+    const u32 v = (values[in[i]] << 18) | (values[in[i+1]] << 12) | (extra == 3 ? values[in[i+2]] << 6 : 0);
+    *output++ = v >> 16;
+    if (extra == 3)
+      *output++ = v >> 8;
+  }
+
+  return output - start;
+}
+
+#ifdef BASE64_X86
+
+/* vector kernels after W. Muła and D. Lemire, "Faster Base64 Encoding and Decoding Using AVX2 Instructions".
+   Each block of 3 bytes is spread on a 32 bit lane, split into 4 indices of 6 bits with multiplies and the
+   indices are turned into characters through a pshufb lookup of the offset of their range. Decoding goes the
+   other way, a block with a character outside of the alphabet is handed to the scalar code. */
+
+__attribute__((target("ssse3"))) static inline __m128i encodeIndices(__m128i in)
+{
+  in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m128i ac = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+  const __m128i bd = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(ac, bd);
+}
+
+__attribute__((target("ssse3"))) static inline __m128i encodeCharacters(__m128i indices)
+{
+  __m128i offsets = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  const __m128i letters = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  offsets = _mm_or_si128(offsets, _mm_and_si128(letters, _mm_set1_epi8(13)));
+  const __m128i shifts = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                       '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  return _mm_add_epi8(_mm_shuffle_epi8(shifts, offsets), indices);
+}
+
+/* 12 bytes are encoded from each 16 bytes load */
+__attribute__((target("ssse3"))) static void encodeSSSE3(const u8 *input, size_t length, char *output)
+{
+  size_t i = 0;
+
+  for (; i + 16 <= length; i += 12, output += 16)
+  {
+    const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), encodeCharacters(encodeIndices(in)));
+  }
+
+  encodeScalar(input + i, length - i, output);
+}
+
+__attribute__((target("ssse3"))) static inline bool decodeValues(__m128i in, __m128i &values)
+{
+  const __m128i lowBits = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m128i highBits = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i rolls = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask = _mm_set1_epi8(0x0F);
+
+  const __m128i high = _mm_and_si128(_mm_srli_epi32(in, 4), mask);
+  const __m128i low = _mm_and_si128(in, mask);
+
+  const __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lowBits, low), _mm_shuffle_epi8(highBits, high));
+  if (_mm_movemask_epi8(_mm_cmpgt_epi8(invalid, _mm_setzero_si128())))
+    return false;
+
+  const __m128i slashes = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+  values = _mm_add_epi8(in, _mm_shuffle_epi8(rolls, _mm_add_epi8(slashes, high)));
+  return true;
+}
+
+__attribute__((target("ssse3"))) static inline __m128i decodeBytes(__m128i values)
+{
+  const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+  return _mm_shuffle_epi8(words, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+/* 16 characters give 12 bytes, only these are stored so that the output needs no slack */
+__attribute__((target("ssse3"))) static size_t decodeSSSE3(const char *input, size_t length, u8 *output)
+{
+  u8 *start = output;
+  size_t i = 0;
+
+  for (; i + 16 <= length; i += 16, output += 12)
+  {
+    __m128i values;
+
+    if (decodeValues(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i)), values))
     {
-      if (extraBytes == 1)
-      {
-        const u8 tmp[] = {input[i*3], '\0', '\0'};
-        inputPiece = tmp;
-      }
-      else
-      {
-        const u8 tmp[] = {input[i*3], input[i*3+1], '\0'};
-        inputPiece = tmp;
-      }
+      const __m128i bytes = decodeBytes(values);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(output), bytes);
+      const u32 last = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+      memcpy(output + 8, &last, sizeof(last));
     }
     else
-      inputPiece = input+(i*3);
-    
-    char *outputPiece = output+(i*4);
+      decodeScalar(input + i, 16, output);
+  }
 
-    outputPiece[0] = base64map[ (inputPiece[0] & 0xFC) >> 2 ];
-    outputPiece[1] = base64map[ ((inputPiece[0] & 0x03) << 4) | ((inputPiece[1] & 0xF0) >> 4) ];
-    
-    if (i*4+2 < *outputLength)
-      outputPiece[2] = base64map[ ((inputPiece[1] & 0x0F) << 2) | ((inputPiece[2] & 0xC0) >> 6) ];
-    if (i*4+3 < *outputLength)
-    outputPiece[3] = base64map[ (inputPiece[2] & 0x3F) ];
+  return (output - start) + decodeScalar(input + i, length - i, output);
+}
+
+/* the AVX2 kernels run the same steps on two blocks of 12 bytes, one for each 128 bit lane */
+__attribute__((target("avx2"))) static void encodeAVX2(const u8 *input, size_t length, char *output)
+{
+  size_t i = 0;
+
+  const __m256i spread = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                         10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+  const __m256i shifts = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                          'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+  for (; i + 28 <= length; i += 24, output += 32)
+  {
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 12));
+    __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+
+    in = _mm256_shuffle_epi8(in, spread);
+    const __m256i ac = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+    const __m256i bd = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+    const __m256i indices = _mm256_or_si256(ac, bd);
+
+    __m256i offsets = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    const __m256i letters = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    offsets = _mm256_or_si256(offsets, _mm256_and_si256(letters, _mm256_set1_epi8(13)));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), _mm256_add_epi8(_mm256_shuffle_epi8(shifts, offsets), indices));
   }
+
+  // the tail is handled by legacy SSE code, which stalls while the upper halves of the registers are dirty
+  _mm256_zeroupper();
+  encodeSSSE3(input + i, length - i, output);
 }
 
-void Files::decode(const char *input, size_t length, u8 **outputPtr, size_t *outputLength)
+__attribute__((target("avx2"))) static size_t decodeAVX2(const char *input, size_t length, u8 *output)
 {
-  size_t rlength = (length/4) * 3;
-  size_t extraBytes = length%4;
-  if (extraBytes) rlength += extraBytes - 1;
-  *outputLength = rlength;
-  
-  *outputPtr = new u8[rlength];
-  
-  size_t j = 0;
-  for (u32 i = 0; i < rlength; ++i)
+  const __m256i lowBits = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                           0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m256i highBits = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i rolls = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                         0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i gather = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  const __m256i mask = _mm256_set1_epi8(0x0F);
+
+  u8 *start = output;
+  size_t i = 0;
+
+  for (; i + 32 <= length; i += 32, output += 24)
   {
-    u8 w = i%3;
-    u8 v1 = value(input[j]);
-    u8 v2 = value(input[j+1]);
-    
-    if (w == 0)
-    {
-      (*outputPtr)[i] = (v1 << 2) | (v2 & 0x30) >> 4;
-      ++j;
-    }
-    else if (w == 1)
-    {
-      (*outputPtr)[i] = ((v1 & 0x0F) << 4) | ((v2 & 0x3C) >> 2);
-      ++j;
-    }
-    else if (w == 2)
+    const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+    const __m256i high = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask);
+    const __m256i low = _mm256_and_si256(in, mask);
+
+    const __m256i invalid = _mm256_and_si256(_mm256_shuffle_epi8(lowBits, low), _mm256_shuffle_epi8(highBits, high));
+    if (_mm256_movemask_epi8(_mm256_cmpgt_epi8(invalid, _mm256_setzero_si256())))
     {
-      (*outputPtr)[i] = ((v1 & 0x03) << 6) | (v2 & 0x3F);
-      j += 2;
+      decodeScalar(input + i, 32, output);
+      continue;
     }
+
+    const __m256i slashes = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/'));
+    const __m256i values = _mm256_add_epi8(in, _mm256_shuffle_epi8(rolls, _mm256_add_epi8(slashes, high)));
+
+    const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    const __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+    const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(words, gather), _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm256_castsi256_si128(bytes));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(output + 16), _mm256_extracti128_si256(bytes, 1));
+  }
+
+  _mm256_zeroupper();
+  return (output - start) + decodeSSSE3(input + i, length - i, output);
+}
+
+#endif
+
+static Files::Base64Kernel bestBase64Kernel()
+{
+#ifdef BASE64_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return Files::Base64Kernel::AVX2;
+  else if (__builtin_cpu_supports("ssse3"))
+    return Files::Base64Kernel::SSSE3;
+#endif
+  return Files::Base64Kernel::SCALAR;
+}
+
+static Files::Base64Kernel base64Kernel = bestBase64Kernel();
+
+bool Files::useBase64Kernel(Base64Kernel kernel)
+{
+  if (kernel > bestBase64Kernel())
+    return false;
+
+  base64Kernel = kernel;
+  return true;
+}
+
+Files::Base64Kernel Files::usedBase64Kernel()
+{
+  return base64Kernel;
+}
+
+size_t Files::encodedLength(size_t length)
+{
+  return (length / 3) * 4 + (length % 3 ? length % 3 + 1 : 0);
+}
+
+size_t Files::decodedLength(size_t length)
+{
+  return (length / 4) * 3 + (length % 4 ? length % 4 - 1 : 0);
+}
+
+size_t Files::encode(const u8 *input, size_t length, char *output)
+{
+  switch (base64Kernel)
+  {
+#ifdef BASE64_X86
+    case Base64Kernel::AVX2: encodeAVX2(input, length, output); break;
+    case Base64Kernel::SSSE3: encodeSSSE3(input, length, output); break;
+#endif
+    default: encodeScalar(input, length, output); break;
+  }
+
+  return encodedLength(length);
+}
+
+size_t Files::decode(const char *input, size_t length, u8 *output)
+{
+  switch (base64Kernel)
+  {
+#ifdef BASE64_X86
+    case Base64Kernel::AVX2: return decodeAVX2(input, length, output);
+    case Base64Kernel::SSSE3: return decodeSSSE3(input, length, output);
+#endif
+    default: return decodeScalar(input, length, output);
   }
 }
 // type x y color direction roteable moveable
@@ -145,21 +357,21 @@ LevelSpec Files::loadLevel(const byte_t *ptr)
 
 void Files::saveLevel(const LevelSpec* level, byte_t **ptr, size_t *length)
 {
-  *length = 1 + 1 + level->name.length() + sizeof(PieceInfo)*level->count();
+  *length = 1 + 1 + level->name().length() + sizeof(PieceInfo)*level->count();
   *ptr = new u8[*length];
   
   u8 *optr = *ptr;
   
-  optr[0] = static_cast<u8>(level->name.length());
+  optr[0] = static_cast<u8>(level->name().length());
   optr[1] = static_cast<u8>(level->count());
 
 #ifdef _WIN32
-  strncpy_s(reinterpret_cast<char*>(optr + 2), *length, level->name.c_str(), level->name.length());
+  strncpy_s(reinterpret_cast<char*>(optr + 2), *length, level->name().data(), level->name().length());
 #else
-  strncpy(reinterpret_cast<char*>(optr + 2), level->name.c_str(), level->name.length());
+  strncpy(reinterpret_cast<char*>(optr + 2), level->name().data(), level->name().length());
 #endif
   
-  PieceInfo* poptr = reinterpret_cast<PieceInfo*>(optr + 2 + level->name.length());
+  PieceInfo* poptr = reinterpret_cast<PieceInfo*>(optr + 2 + level->name().length());
   
   for (u32 i = 0; i < level->count(); ++i)
   {
@@ -215,35 +427,114 @@ std::vector<LevelPack> Files::loadPacks()
   return packs;
 }
 
+/* levels of a base64 pack, each one is read back from its own line of the file when it's needed,
+   the file is only open while a line is read so a pack keeps nothing but where its lines start */
+class Base64Levels : public LazyLevels
+{
+private:
+  string path;
+  vector<streamoff> lines;
+  
+protected:
+  LevelSpec decode(u32 index) override
+  {
+    ifstream in(path);
+    string line;
+    
+    in.seekg(lines[index]);
+    
+    if (!getline(in, line))
+    {
+      printf("Invalid level %u in %s\n", index, path.c_str());
+      return LevelSpec("");
+    }
+    
+    vector<u8> output(Files::decodedLength(line.length()));
+    const size_t length = Files::decode(line.c_str(), line.length(), output.data());
+    
+    // the file changed since the pack was loaded or the line is truncated
+    if (length < 2 || length < 2 + output[0] + output[1]*sizeof(PieceInfo))
+    {
+      printf("Invalid level %u in %s\n", index, path.c_str());
+      return LevelSpec("");
+    }
+    
+    return Files::loadLevel(output.data());
+  }
+  
+public:
+  Base64Levels(const string& path, vector<streamoff> lines) : LazyLevels(lines.size()), path(path), lines(std::move(lines)) { }
+};
+
+/* levels of a binary pack, the file stays mapped and each level is decoded from its entry when it's needed */
+class BinaryLevels : public LazyLevels
+{
+private:
+  unique_ptr<PackFile> file;
+  string path;
+  
+protected:
+  LevelSpec decode(u32 index) override
+  {
+    LevelSpec level("");
+    
+    if (!file->level(index, level))
+    {
+      printf("Invalid level %u in %s\n", index, path.c_str());
+      return LevelSpec("");
+    }
+    
+    return level;
+  }
+  
+public:
+  BinaryLevels(unique_ptr<PackFile> pack, const string& path) : LazyLevels(pack->count()), file(std::move(pack)), path(path) { }
+};
+
 LevelPack Files::loadPack(const std::string& filename)
 {
   ifstream in(PATH_PAK+filename);
   
-  u8 *output;
+  vector<u8> output;
   size_t outputLength;
   string line;
   
+  u8 magic[4] = {0};
+  in.read(reinterpret_cast<char*>(magic), sizeof(magic));
+  
+  if (PackFile::matches(magic, in.gcount()))
+  {
+    unique_ptr<PackFile> file(new PackFile());
+    
+    if (!file->open(PATH_PAK+filename))
+      throw exception();
+    
+    // only the header is read now, a level is validated when it's first used
+    const string name = file->name(), author = file->author();
+    return LevelPack(name, author, filename, make_shared<BinaryLevels>(std::move(file), PATH_PAK+filename));
+  }
+  
+  in.clear();
+  in.seekg(0);
+  
   if (in)
   {
     getline(in, line);
-    decode(line.c_str(), line.length(), &output, &outputLength);
-    u8 nameLength = static_cast<u8>(output[0]);
+    output.resize(decodedLength(line.length()));
+    outputLength = decode(line.c_str(), line.length(), output.data());
+    u8 nameLength = output[0];
     
     string name = string(reinterpret_cast<const char *>(&output[1]),nameLength);
     string author = string(reinterpret_cast<const char *>(&output[1+nameLength]),outputLength - 1 - nameLength);
     
-    delete [] output;
+    // only where each level starts is read now, levels are decoded when they are used
+    vector<streamoff> lines;
     
-    LevelPack pack = LevelPack(name, author, filename);
+    for (streamoff offset = in.tellg(); getline(in, line); offset = in.tellg())
+      if (!line.empty())
+        lines.push_back(offset);
     
-    while (getline(in, line))
-    {
-      decode(line.c_str(), line.length(), &output, &outputLength);
-
-      pack.addLevel(loadLevel(static_cast<const u8 *>(output)));
-      
-      delete [] output;
-    }
+    LevelPack pack = LevelPack(name, author, filename, make_shared<Base64Levels>(PATH_PAK+filename, std::move(lines)));
     
     return pack;
   }
@@ -251,36 +542,47 @@ LevelPack Files::loadPack(const std::string& filename)
     throw exception();
 }
 
+bool Files::saveBinaryPack(const LevelPack& pack)
+{
+  return PackFile::write(pack, PATH_PAK+pack.path()+".pak");
+}
+
 void Files::savePack(const LevelPack& pack)
 {
-  ofstream os(PATH_PAK+pack.path()+".pak");
-  
-  char *output;
+  vector<char> output;
   size_t outputLength;
   
-  if (os)
+  stringstream ss;
+  ss << (u8)pack.name().length() << pack.name() << pack.author();
+  
+  std::string header = ss.str();
+  
+  output.resize(encodedLength(header.length()));
+  outputLength = encode(reinterpret_cast<const u8*>(header.c_str()), header.length(), output.data());
+  
+  // the whole pack is encoded before the file is opened, levels of a lazy pack may still be read from it
+  std::string encoded = std::string(output.data(), outputLength) + '\n';
+  
+  for (int i = 0; i < pack.count(); ++i)
   {
-    stringstream ss;
-    ss << (u8)pack.name().length() << pack.name() << pack.author();
+    u8 *levelOutput;
+    size_t levelOutputLength;
     
-    std::string header = ss.str();
+    saveLevel(pack.at(i).get(), &levelOutput, &levelOutputLength);
     
-    encode(reinterpret_cast<const u8*>(header.c_str()), header.length(), &output, &outputLength);
-    os.write(output, outputLength) << endl;
-    delete [] output;
+    if (output.size() < encodedLength(levelOutputLength))
+      output.resize(encodedLength(levelOutputLength));
     
-    for (int i = 0; i < pack.count(); ++i)
-    {
-      u8 *levelOutput;
-      size_t levelOutputLength;
-      
-      saveLevel(pack.at(i), &levelOutput, &levelOutputLength);
-      encode(levelOutput, levelOutputLength, &output, &outputLength);
-      os.write(output, outputLength) << endl;
-      delete [] output;
-      delete [] levelOutput;
-    }
+    outputLength = encode(levelOutput, levelOutputLength, output.data());
+    encoded.append(output.data(), outputLength);
+    encoded += '\n';
+    delete [] levelOutput;
   }
+  
+  ofstream os(PATH_PAK+pack.path()+".pak");
+  
+  if (os)
+    os << encoded;
 }
 
 
@@ -289,17 +591,19 @@ void Files::loadSolvedStatus()
 {
   ifstream in(PATH_SAVE+"save.dat");
   string line;
+  vector<u8> output;
   
   if (in)
   {
     while (getline(in, line))
     {
-      u8 *output;
-      size_t outputLength;
+      output.resize(decodedLength(line.length()));
+      decode(line.c_str(), line.length(), output.data());
       
-      decode(line.c_str(), line.length(), &output, &outputLength);
+      if (output.empty())
+        continue;
       
-      string packName = string(reinterpret_cast<const char *>(output+1), output[0]);
+      string packName = string(reinterpret_cast<const char *>(output.data()+1), output[0]);
       
       //TODO: reimplement separated from LevelPack
       /*
@@ -307,7 +611,7 @@ void Files::loadSolvedStatus()
       {
         if (pack.path() == packName)
         {
-          u8 *status = output + 1 + output[0];
+          u8 *status = output.data() + 1 + output[0];
           
           for (int i = 0; i < pack.count(); ++i)
           {
@@ -326,8 +630,6 @@ void Files::loadSolvedStatus()
         }
       }
       */
-      
-      delete [] output;
     }
   }
 }
@@ -364,13 +666,10 @@ void Files::saveSolvedStatus()
       
       string result = ss.str();
       
-      char *output;
-      size_t outputLength;
-      encode(reinterpret_cast<const u8*>(result.c_str()), result.length(), &output, &outputLength);
+      string output(encodedLength(result.length()), '\0');
+      encode(reinterpret_cast<const u8*>(result.c_str()), result.length(), &output[0]);
       os << output;
       os << endl;
-      
-      delete [] output;
     }
   }*/
 }
@@ -22,8 +22,22 @@ class Field;
 class Files
 {  
 public:
-  static void encode(const u8 *input, size_t length, char **outputPtr, size_t *outputLength);
-  static void decode(const char *input, size_t length, u8 **outputPtr, size_t *outputLength);
+  /* kernels of the base64 functions, the best one the cpu supports is used by default */
+  enum class Base64Kernel
+  {
+    SCALAR,
+    SSSE3,
+    AVX2
+  };
+  
+  static bool useBase64Kernel(Base64Kernel kernel);
+  static Base64Kernel usedBase64Kernel();
+  
+  static size_t encodedLength(size_t length);
+  static size_t decodedLength(size_t length);
+  /* output must hold encodedLength(length) or decodedLength(length) bytes, the written length is returned */
+  static size_t encode(const u8 *input, size_t length, char *output);
+  static size_t decode(const char *input, size_t length, u8 *output);
   
   static LevelSpec loadLevel(const byte_t *ptr);
   static void saveLevel(const LevelSpec* level, byte_t **ptr, size_t *length);
@@ -36,6 +50,8 @@ public:
   static std::vector<LevelPack> loadPacks();
   static LevelPack loadPack(const std::string& filename);
   static void savePack(const LevelPack& pack);
+  /* same pack in the binary format read in place by PackFile */
+  static bool saveBinaryPack(const LevelPack& pack);
 
   static u32 selectedPack;
   
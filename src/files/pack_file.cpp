@@ -0,0 +1,217 @@
+#include "pack_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/* 0x89 is outside of the base64 alphabet so a binary pack is never mistaken for a base64 one */
+const u8 PackFile::MAGIC[4] = { 0x89, 'L', 'Z', 'P' };
+
+template<typename T> static T readValue(const u8* data)
+{
+  T value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i)
+    value |= static_cast<T>(data[i]) << (8 * i);
+  return value;
+}
+
+template<typename T> static void writeValue(u8* data, T value)
+{
+  for (size_t i = 0; i < sizeof(T); ++i)
+    data[i] = static_cast<u8>(value >> (8 * i));
+}
+
+bool PackFile::matches(const u8* data, size_t length)
+{
+  return length >= sizeof(MAGIC) && !memcmp(data, MAGIC, sizeof(MAGIC));
+}
+
+void PackFile::close()
+{
+#ifndef _WIN32
+  if (data)
+    munmap(const_cast<u8*>(data), length);
+#else
+  buffer.clear();
+#endif
+
+  data = nullptr;
+  length = 0;
+  levels = 0;
+}
+
+bool PackFile::open(const string& path)
+{
+  close();
+
+#ifndef _WIN32
+  int fd = ::open(path.c_str(), O_RDONLY);
+
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+
+  if (fstat(fd, &info) || info.st_size < static_cast<off_t>(HEADER_SIZE))
+  {
+    ::close(fd);
+    return false;
+  }
+
+  void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+    return false;
+
+  data = static_cast<const u8*>(mapping);
+  length = info.st_size;
+#else
+  FILE* in = fopen(path.c_str(), "rb");
+
+  if (!in)
+    return false;
+
+  fseek(in, 0, SEEK_END);
+  buffer.resize(std::max(0L, ftell(in)));
+  fseek(in, 0, SEEK_SET);
+  const bool read = fread(buffer.data(), 1, buffer.size(), in) == buffer.size();
+  fclose(in);
+
+  if (!read || buffer.size() < HEADER_SIZE)
+    return false;
+
+  data = buffer.data();
+  length = buffer.size();
+#endif
+
+  const u32 version = readValue<u32>(data + 4), count = readValue<u32>(data + 8), offset = readValue<u32>(data + 12);
+  const u8 nameLength = data[16], authorLength = data[17];
+  const size_t strings = HEADER_SIZE + nameLength + authorLength;
+
+  if (!matches(data, length) || version != VERSION || strings > length ||
+      offset < strings || offset > length || (length - offset) / ENTRY_SIZE < count)
+  {
+    close();
+    return false;
+  }
+
+  levels = count;
+  index = offset;
+  _name.assign(reinterpret_cast<const char*>(data + HEADER_SIZE), nameLength);
+  _author.assign(reinterpret_cast<const char*>(data + HEADER_SIZE + nameLength), authorLength);
+
+  return true;
+}
+
+bool PackFile::level(u32 i, LevelSpec& level) const
+{
+  assert(i < levels);
+
+  const u8* entry = data + index + i * ENTRY_SIZE;
+  const u32 offset = readValue<u32>(entry);
+  const u16 pieces = readValue<u16>(entry + 4);
+  const u8 nameLength = entry[6];
+  const size_t size = nameLength + pieces * PIECE_SIZE;
+
+  if (offset > length || length - offset < size)
+    return false;
+
+  level = LevelSpec(string_view(reinterpret_cast<const char*>(data + offset), nameLength));
+
+  for (const u8* piece = data + offset + nameLength; piece < data + offset + size; piece += PIECE_SIZE)
+  {
+    PieceInfo info(PIECE_WALL);
+
+    if (!readPiece(piece, info))
+      return false;
+
+    level.add(info);
+  }
+
+  return true;
+}
+
+void PackFile::writePiece(const PieceInfo& info, u8* piece)
+{
+  piece[0] = static_cast<u8>(info.type);
+  piece[1] = static_cast<u8>(info.x);
+  piece[2] = static_cast<u8>(info.y);
+  piece[3] = static_cast<u8>(info.color);
+  piece[4] = static_cast<u8>(info.direction);
+  piece[5] = (info.inventory ? INVENTORY : 0) | (info.moveable ? MOVEABLE : 0) | (info.roteable ? ROTEABLE : 0);
+}
+
+bool PackFile::readPiece(const u8* piece, PieceInfo& info)
+{
+  const u8 flags = piece[5];
+
+  // coordinates depend on the field, Field::load drops the pieces which are out of it
+  if (piece[0] >= PIECES_COUNT || piece[3] > LaserColor::WHITE || piece[4] > Direction::NORTH_WEST || (flags & ~(INVENTORY | MOVEABLE | ROTEABLE)))
+    return false;
+
+  info = PieceInfo(static_cast<PieceType>(piece[0]));
+  info.inventory = (flags & INVENTORY) != 0;
+  info.x = static_cast<s8>(piece[1]);
+  info.y = static_cast<s8>(piece[2]);
+  info.color = static_cast<LaserColor>(piece[3]);
+  info.direction = static_cast<Direction>(piece[4]);
+  info.moveable = (flags & MOVEABLE) != 0;
+  info.roteable = (flags & ROTEABLE) != 0;
+  return true;
+}
+
+bool PackFile::write(const LevelPack& pack, const string& path)
+{
+  const u8 nameLength = static_cast<u8>(std::min<size_t>(pack.name().length(), 255));
+  const u8 authorLength = static_cast<u8>(std::min<size_t>(pack.author().length(), 255));
+  const u32 index = static_cast<u32>(HEADER_SIZE + nameLength + authorLength);
+
+  vector<u8> output(index + pack.count() * ENTRY_SIZE);
+  memcpy(output.data(), MAGIC, sizeof(MAGIC));
+  writeValue(output.data() + 4, VERSION);
+  writeValue(output.data() + 8, static_cast<u32>(pack.count()));
+  writeValue(output.data() + 12, index);
+  output[16] = nameLength;
+  output[17] = authorLength;
+  memcpy(output.data() + HEADER_SIZE, pack.name().data(), nameLength);
+  memcpy(output.data() + HEADER_SIZE + nameLength, pack.author().data(), authorLength);
+
+  for (u32 i = 0; i < pack.count(); ++i)
+  {
+    const LevelRef level = pack.at(i);
+    const std::string_view levelName = level->name();
+    const u8 levelNameLength = static_cast<u8>(std::min<size_t>(levelName.length(), 255));
+    u8* entry = output.data() + index + i * ENTRY_SIZE;
+
+    writeValue(entry, static_cast<u32>(output.size()));
+    writeValue(entry + 4, static_cast<u16>(level->count()));
+    entry[6] = levelNameLength;
+
+    output.insert(output.end(), levelName.begin(), levelName.begin() + levelNameLength);
+
+    for (size_t j = 0; j < level->count(); ++j)
+    {
+      u8 piece[PIECE_SIZE];
+      writePiece(level->at(j), piece);
+      output.insert(output.end(), piece, piece + PIECE_SIZE);
+    }
+  }
+
+  FILE* out = fopen(path.c_str(), "wb");
+
+  if (!out)
+    return false;
+
+  const bool written = fwrite(output.data(), 1, output.size(), out) == output.size();
+  return !fclose(out) && written;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "files/repository.h"
+
+#include <string>
+#include <vector>
+
+/* binary level pack read through a memory mapping:
+   header, pack name and author, an index with one entry per level, then each level as its name followed by
+   its pieces. Integers are little endian and every piece is PIECE_SIZE explicit bytes, so the file doesn't
+   depend on the layout of PieceInfo. Opening only reads the header, a level only touches its index entry and its bytes. */
+class PackFile
+{
+public:
+  static constexpr u32 VERSION = 2;
+  /* type, x, y, color, direction, flags */
+  static constexpr size_t PIECE_SIZE = 6;
+
+private:
+  /* magic, version, levels, index offset, name and author lengths */
+  static constexpr size_t HEADER_SIZE = 4 + 4 + 4 + 4 + 1 + 1;
+  /* offset, pieces, name length */
+  static constexpr size_t ENTRY_SIZE = 4 + 2 + 1;
+  enum PieceFlags : u8
+  {
+    INVENTORY = 0x01,
+    MOVEABLE  = 0x02,
+    ROTEABLE  = 0x04
+  };
+
+  static const u8 MAGIC[4];
+
+  const u8* data;
+  size_t length;
+#ifdef _WIN32
+  std::vector<u8> buffer;
+#endif
+
+  u32 levels;
+  u32 index;
+  std::string _name;
+  std::string _author;
+
+  void close();
+
+public:
+  PackFile() : data(nullptr), length(0), levels(0), index(0) { }
+  PackFile(const PackFile&) = delete;
+  PackFile& operator=(const PackFile&) = delete;
+  ~PackFile() { close(); }
+
+  /* first bytes of a file in this format, they can't start a base64 pack */
+  static bool matches(const u8* data, size_t length);
+
+  bool open(const std::string& path);
+
+  size_t count() const { return levels; }
+  const std::string& name() const { return _name; }
+  const std::string& author() const { return _author; }
+
+  /* false when the entry is out of the file or one of its pieces has a type, color, direction or flag out of range,
+     coordinates aren't checked since they depend on the field */
+  bool level(u32 index, LevelSpec& level) const;
+
+  static bool write(const LevelPack& pack, const std::string& path);
+
+  /* PIECE_SIZE bytes of a piece, also used by the Aargon cache; reading fails on the same values as level() */
+  static void writePiece(const PieceInfo& info, u8* piece);
+  static bool readPiece(const u8* piece, PieceInfo& info);
+};
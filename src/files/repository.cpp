@@ -1 +1,173 @@
 #include "repository.h"
+
+#include <cstring>
+#include <mutex>
+#include <new>
+
+std::shared_ptr<LevelArena> LevelArena::create(const std::vector<LevelSpec>& levels)
+{
+  static_assert(sizeof(LevelArena) % alignof(LevelSpec) == 0, "levels must follow the arena aligned");
+
+  size_t pieces = 0, names = 0;
+
+  for (const LevelSpec& level : levels)
+  {
+    pieces += level.count();
+    names += level.name().length();
+  }
+
+  const size_t specsBytes = sizeof(LevelSpec) * levels.size();
+  u8* memory = static_cast<u8*>(::operator new(sizeof(LevelArena) + specsBytes + sizeof(PieceInfo) * pieces + names));
+
+  LevelArena* arena = new (memory) LevelArena(static_cast<u32>(levels.size()));
+  LevelSpec* specs = reinterpret_cast<LevelSpec*>(memory + sizeof(LevelArena));
+  PieceInfo* pieceData = reinterpret_cast<PieceInfo*>(memory + sizeof(LevelArena) + specsBytes);
+  char* nameData = reinterpret_cast<char*>(pieceData + pieces);
+
+  for (size_t i = 0; i < levels.size(); ++i)
+  {
+    const LevelSpec& level = levels[i];
+    const std::string_view name = level.name();
+
+    if (level.count())
+      memcpy(pieceData, level.data(), sizeof(PieceInfo) * level.count());
+    if (name.length())
+      memcpy(nameData, name.data(), name.length());
+
+    LevelSpec* spec = new (specs + i) LevelSpec(std::string_view(nameData, name.length()), pieceData, level.count());
+    spec->solved = level.solved;
+
+    pieceData += level.count();
+    nameData += name.length();
+  }
+
+  return std::shared_ptr<LevelArena>(arena, &LevelArena::destroy);
+}
+
+void LevelArena::destroy(LevelArena* arena)
+{
+  for (u32 i = 0; i < arena->levels; ++i)
+    arena->specs()[i].~LevelSpec();
+
+  arena->~LevelArena();
+  ::operator delete(arena);
+}
+
+/* decoded levels from the most to the least recently used one */
+struct CacheState
+{
+  std::mutex lock;
+  std::list<LazyLevels::Slot> slots;
+  size_t budget = 8 << 20;
+  size_t usage = 0;
+
+  /* the level which was just used is never evicted, even if it doesn't fit the budget by itself */
+  void trim()
+  {
+    while (usage > budget && slots.size() > 1)
+    {
+      const LazyLevels::Slot& slot = slots.back();
+      slot.owner->release(slot.index);
+    }
+  }
+};
+
+/* never destroyed, packs held by globals may still release their levels at exit */
+static CacheState& cache()
+{
+  static CacheState* state = new CacheState();
+  return *state;
+}
+
+LazyLevels::~LazyLevels()
+{
+  std::lock_guard<std::mutex> guard(cache().lock);
+
+  for (u32 i = 0; i < levels.size(); ++i)
+    if (levels[i])
+      release(i);
+}
+
+/* the level is only dropped by the cache, a LevelRef may still hold it */
+void LazyLevels::release(u32 index)
+{
+  CacheState& state = cache();
+  state.usage -= slots[index]->bytes;
+  state.slots.erase(slots[index]);
+  levels[index].reset();
+}
+
+/* what a cached level keeps allocated: the LevelSpec with the control block of its shared_ptr, its name and pieces,
+   the node of its slot in the list and a rough allocator header for each of these blocks */
+static size_t footprint(const LevelSpec& level)
+{
+  const size_t header = 2 * sizeof(void*);
+  const size_t control = 2 * sizeof(long) + sizeof(void*);
+  const size_t node = sizeof(LazyLevels::Slot) + 2 * sizeof(void*);
+  
+  return sizeof(LevelSpec) + control + level.name().size() + sizeof(PieceInfo) * level.count() + node + 4 * header;
+}
+
+LevelRef LazyLevels::at(u32 index)
+{
+  CacheState& state = cache();
+  
+  {
+    std::lock_guard<std::mutex> guard(state.lock);
+    
+    if (const std::shared_ptr<const LevelSpec>& level = levels[index])
+    {
+      state.slots.splice(state.slots.begin(), state.slots, slots[index]);
+      return LevelRef(level.get(), level);
+    }
+  }
+  
+  // decoding may read a file so it's done unlocked, another thread could have cached the level meanwhile
+  std::shared_ptr<const LevelSpec> decoded = std::make_shared<const LevelSpec>(decode(index));
+  
+  std::lock_guard<std::mutex> guard(state.lock);
+  
+  std::shared_ptr<const LevelSpec>& level = levels[index];
+  
+  if (level)
+  {
+    state.slots.splice(state.slots.begin(), state.slots, slots[index]);
+    return LevelRef(level.get(), level);
+  }
+  
+  level = std::move(decoded);
+  LevelRef ref(level.get(), level);
+  
+  const size_t bytes = footprint(*level);
+  
+  state.slots.push_front({ this, index, bytes });
+  state.usage += bytes;
+  slots[index] = state.slots.begin();
+  
+  state.trim();
+  
+  return ref;
+}
+
+void LevelCache::setBudget(size_t bytes)
+{
+  CacheState& state = cache();
+  std::lock_guard<std::mutex> guard(state.lock);
+
+  state.budget = bytes;
+  state.trim();
+}
+
+size_t LevelCache::budget()
+{
+  CacheState& state = cache();
+  std::lock_guard<std::mutex> guard(state.lock);
+  return state.budget;
+}
+
+size_t LevelCache::usage()
+{
+  CacheState& state = cache();
+  std::lock_guard<std::mutex> guard(state.lock);
+  return state.usage;
+}
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cassert>
+#include <list>
+#include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 
 #include "common/common.h"
 
@@ -48,22 +52,123 @@ struct LevelSpec
 {
 private:
   std::vector<PieceInfo> pieces;
+  std::string ownedName;
+  /* pieces and name owned by someone else, eg. an arena or the data of a cache, which must outlive the level */
+  const PieceInfo* view;
+  size_t viewCount;
+  std::string_view viewName;
+  bool borrowed;
   
 public:
-  LevelSpec(const std::string& name) : name(name), solved(false) { }
+  LevelSpec(std::string_view name) : ownedName(name), view(nullptr), viewCount(0), borrowed(false), solved(false) { }
+  LevelSpec(std::string_view name, const PieceInfo* pieces, size_t count) : view(pieces), viewCount(count), viewName(name), borrowed(true), solved(false) { }
   
-  void add(PieceInfo piece) { pieces.push_back(piece); }
-  size_t count() const { return pieces.size(); }
-  const PieceInfo& at(size_t index) const { return pieces[index]; }
+  void add(PieceInfo piece) { assert(!borrowed); pieces.push_back(piece); }
+  size_t count() const { return borrowed ? viewCount : pieces.size(); }
+  const PieceInfo& at(size_t index) const { return borrowed ? view[index] : pieces[index]; }
+  const PieceInfo* data() const { return borrowed ? view : pieces.data(); }
+  std::string_view name() const { return borrowed ? viewName : std::string_view(ownedName); }
   
-  std::string name;
   bool solved;
 };
 
+/* reference to a level of a pack, which stays in memory as long as a reference to it exists even if the pack is gone
+   or LevelCache dropped it meanwhile */
+class LevelRef
+{
+private:
+  const LevelSpec* spec;
+  std::shared_ptr<const void> owner;
+  
+public:
+  LevelRef() : spec(nullptr) { }
+  LevelRef(const LevelSpec* spec, std::shared_ptr<const void> owner) : spec(spec), owner(std::move(owner)) { }
+  
+  const LevelSpec* get() const { return spec; }
+  const LevelSpec* operator->() const { return spec; }
+  const LevelSpec& operator*() const { return *spec; }
+  explicit operator bool() const { return spec != nullptr; }
+};
+
+/* owner of the levels of a pack, shared by the copies of the pack */
+class LevelStorage
+{
+public:
+  virtual ~LevelStorage() { }
+  
+  virtual size_t count() const = 0;
+  virtual LevelRef at(u32 index) = 0;
+};
+
+/* every level of a pack in a single allocation: the LevelSpecs, then the PieceInfo records and the pool of the
+   names they view. An arena never changes once it's built. */
+class alignas(LevelSpec) LevelArena : public LevelStorage, public std::enable_shared_from_this<LevelArena>
+{
+private:
+  u32 levels;
+  
+  LevelArena(u32 levels) : levels(levels) { }
+  
+  const LevelSpec* specs() const { return reinterpret_cast<const LevelSpec*>(this + 1); }
+  static void destroy(LevelArena* arena);
+  
+public:
+  /* everything is copied, also the pieces of the levels which borrow them */
+  static std::shared_ptr<LevelArena> create(const std::vector<LevelSpec>& levels);
+  
+  size_t count() const override { return levels; }
+  LevelRef at(u32 index) override { return LevelRef(specs() + index, shared_from_this()); }
+};
+
+/* levels of a pack which are decoded on first access, LevelCache drops the least recently used ones */
+class LazyLevels : public LevelStorage
+{
+public:
+  /* entry of a decoded level in the list of LevelCache */
+  struct Slot
+  {
+    LazyLevels* owner;
+    u32 index;
+    size_t bytes;
+  };
+  
+private:
+  std::vector<std::shared_ptr<const LevelSpec>> levels;
+  std::vector<std::list<Slot>::iterator> slots;
+  
+  void release(u32 index);
+  
+protected:
+  /* level read back from the source of the pack, an empty one if it can't be read, it's called without the cache
+     locked and may run for several indices at once */
+  virtual LevelSpec decode(u32 index) = 0;
+  
+public:
+  LazyLevels(size_t count) : levels(count), slots(count) { }
+  LazyLevels(const LazyLevels&) = delete;
+  LazyLevels& operator=(const LazyLevels&) = delete;
+  virtual ~LazyLevels();
+  
+  size_t count() const override { return levels.size(); }
+  LevelRef at(u32 index) override;
+  
+  friend struct CacheState;
+};
+
+/* memory budget shared by every LazyLevels, it counts the levels held by the cache and not the ones it dropped which
+   are still referenced */
+class LevelCache
+{
+public:
+  static void setBudget(size_t bytes);
+  static size_t budget();
+  static size_t usage();
+};
+
 class LevelPack
 {
 private:
-  std::vector<LevelSpec> levels;
+  std::shared_ptr<LevelStorage> levels;
   
   std::string _name;
   std::string _author;
@@ -71,10 +176,14 @@ private:
   
 public:
   LevelPack(const std::string& name, const std::string& author, const std::string& path) : _name(name), _author(author), _path(path), selected(0), solvedCount(0) { }
-  void addLevel(LevelSpec level) { levels.push_back(level); }
+  /* levels are copied in an arena */
+  LevelPack(const std::string& name, const std::string& author, const std::string& path, const std::vector<LevelSpec>& levels) :
+    LevelPack(name, author, path) { this->levels = LevelArena::create(levels); }
+  LevelPack(const std::string& name, const std::string& author, const std::string& path, std::shared_ptr<LevelStorage> levels) :
+    LevelPack(name, author, path) { this->levels = std::move(levels); }
   
-  size_t count() const { return levels.size(); }
-  const LevelSpec *at(u32 index) const { return &levels[index]; }
+  size_t count() const { return levels ? levels->count() : 0; }
+  LevelRef at(u32 index) const { return levels->at(index); }
   
   const std::string& author() const { return _author; }
   const std::string& name() const { return _name; }
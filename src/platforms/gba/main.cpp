@@ -42,7 +42,7 @@ public:
   };
   
 public:
-  void drawPiece(tile_entry* dest, u32 x, u32 y, Piece* piece)
+  void drawPiece(tile_entry* dest, u32 x, u32 y, const Piece* piece)
   {
     dest = dest+(y*2)*32+(x*2);
     
@@ -113,7 +113,7 @@ public:
     const auto& piece = tile->piece();
     
     if (piece)
-      drawPiece(gfx.getBgTileMap(17), x, y, piece.get());
+      drawPiece(gfx.getBgTileMap(17), x, y, piece);
   }
   
   void dummyInit()
@@ -122,9 +122,9 @@ public:
     
     for (int i = 0; i < 8; ++i)
     {
-      field.place(Pos(2+i, 2), new Piece(PIECE_MIRROR, (Direction)i));
-      field.place(Pos(2+i, 3), new Piece(PIECE_PRISM, (Direction)i));
-      field.place(Pos(2+i, 6), new Piece(PIECE_SOURCE, (Direction)i, LaserColor::RED));
+      field.place(Pos(2+i, 2), Piece(PIECE_MIRROR, (Direction)i));
+      field.place(Pos(2+i, 3), Piece(PIECE_PRISM, (Direction)i));
+      field.place(Pos(2+i, 6), Piece(PIECE_SOURCE, (Direction)i, LaserColor::RED));
     }
   }
 };
@@ -287,6 +287,7 @@ int main(void)
       if (piece && piece->canBeRotated())
       {
         piece->rotateLeft();
+        field.invalidate(hover);
         levelView.refreshPiece(hover.x, hover.y);
       }
     }
@@ -296,6 +297,7 @@ int main(void)
       if (piece && piece->canBeRotated())
       {
         piece->rotateRight();
+        field.invalidate(hover);
         levelView.refreshPiece(hover.x, hover.y);
       }
     }
@@ -28,7 +28,7 @@ void Game::init()
   running = true;  
 
   
-  auto apacks = Aargon::parseLevels();
+  auto apacks = Aargon::loadLevels();
   packs.move(apacks);
   apacks.clear();
   
@@ -41,6 +41,7 @@ void Game::init()
   //Files::loadSolvedStatus();
   
   field->generateDummy();
+  field->setIncremental(true);
 
   if (packs.packCount() > 0)
     pack = &packs[0];
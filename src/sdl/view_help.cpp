@@ -25,8 +25,7 @@ public:
     for (size_t i = 0; i < level.length(); i += 5)
     {
       PieceInfo info = encoder.decodePieceFromString(&level[i], false);
-      Piece* piece = field->generatePiece(info);
-      field->place(Position(info.x, info.y), piece);
+      field->place(Position(info.x, info.y), field->generatePiece(info));
       field->updateLasers();
     }
   }
@@ -63,7 +63,7 @@ struct PieceGfx
   SDL_Rect rect;
   int rotation;
 
-  PieceGfx(const Piece* piece, Mode mode, int x, int y) : rect({ x * ui::PIECE_SIZE, y * ui::PIECE_SIZE, ui::PIECE_SIZE, ui::PIECE_SIZE })
+  PieceGfx(Direction orientation, Mode mode, int x, int y) : rect({ x * ui::PIECE_SIZE, y * ui::PIECE_SIZE, ui::PIECE_SIZE, ui::PIECE_SIZE })
   {
     constexpr bool forceRotations = true;
     
@@ -72,11 +72,11 @@ struct PieceGfx
       case Mode::HAS_HALF_ROTATION:
       {
         if (forceRotations)
-          rotation = piece->orientation();
+          rotation = orientation;
         else
         {
-          if (!isOrtho(piece->orientation())) rect.x += ui::PIECE_SIZE;
-          rotation = (piece->orientation() / 2) * 2;
+          if (!isOrtho(orientation)) rect.x += ui::PIECE_SIZE;
+          rotation = (orientation / 2) * 2;
         }
 
         break;
@@ -90,50 +90,53 @@ struct PieceGfx
 };
 
 PieceGfx LevelView::gfxForPiece(const Piece* piece)
+{
+  return gfxForPiece(piece->type(), piece->orientation(), piece->color(), false);
+}
+
+PieceGfx LevelView::gfxForPiece(PieceType type, Direction orientation, LaserColor laserColor, bool satisfied)
 {
   Position gfx = Position(0,0);
-  int angle = piece->orientation();
 
-  int color = piece->color();
-  int orientaton = piece->orientation();
-  const Direction o = piece->orientation();
+  int color = laserColor;
+  int orientaton = orientation;
  
-  switch (piece->type())
+  switch (type)
   {
   case PIECE_WALL: return PieceGfx(13, 7);
   case PIECE_GLASS: return PieceGfx(11, 7);
     
-  case PIECE_SOURCE: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 0, 1);
-  case PIECE_MIRROR: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 0, 0);
-
-    case PIECE_SKEW_MIRROR: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 4, 2);
-    case PIECE_DOUBLE_MIRROR: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 2, 2);
-    case PIECE_DOUBLE_SPLITTER_MIRROR: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 4, 4);
-    case PIECE_DOUBLE_PASS_MIRROR: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 0, 2);
-    case PIECE_DOUBLE_SKEW_MIRROR: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 4, 3);
-    case PIECE_REFRACTOR: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 4, 1);
-
-    case PIECE_SPLITTER: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 2, 0);
-    case PIECE_ANGLED_SPLITTER: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 4, 0);
-    case PIECE_THREE_WAY_SPLITTER: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 2, 1);
+  case PIECE_SOURCE: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 0, 1);
+  case PIECE_MIRROR: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 0, 0);
+
+    case PIECE_SKEW_MIRROR: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 4, 2);
+    case PIECE_DOUBLE_MIRROR: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 2, 2);
+    case PIECE_DOUBLE_SPLITTER_MIRROR: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 4, 4);
+    case PIECE_DOUBLE_PASS_MIRROR: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 0, 2);
+    case PIECE_DOUBLE_SKEW_MIRROR: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 4, 3);
+    case PIECE_REFRACTOR: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 4, 1);
+
+    case PIECE_SPLITTER: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 2, 0);
+    case PIECE_ANGLED_SPLITTER: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 4, 0);
+    case PIECE_THREE_WAY_SPLITTER: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 2, 1);
     case PIECE_STAR_SPLITTER: gfx = Position(8, 9); break;
-    case PIECE_PRISM: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 0, 3);
-    case PIECE_FLIPPED_PRISM: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 2, 3);
+    case PIECE_PRISM: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 0, 3);
+    case PIECE_FLIPPED_PRISM: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 2, 3);
 
     case PIECE_FILTER: return PieceGfx(0, 8 + color);
     case PIECE_ROUND_FILTER: gfx = Position(orientaton % 4, 9); break;
-    case PIECE_POLARIZER: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 1, 8 + color);
-    case PIECE_TUNNEL: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 0, 7);
+    case PIECE_POLARIZER: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 1, 8 + color);
+    case PIECE_TUNNEL: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 0, 7);
 
     case PIECE_RIGHT_BENDER: gfx = Position(14, 7); break;
     case PIECE_RIGHT_TWISTER: gfx = Position(12, 7); break;
     case PIECE_LEFT_BENDER: gfx = Position(10, 7); break;
     case PIECE_LEFT_TWISTER: gfx = Position(9, 7); break;
 
-    case PIECE_SELECTOR: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 3, 8 + color);
-    case PIECE_SPLICER: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 5, 8 + color);
-    case PIECE_COLOR_SHIFTER: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 2, 6);
-    case PIECE_COLOR_INVERTER: return PieceGfx(piece, PieceGfx::Mode::HAS_HALF_ROTATION, 0, 6);
+    case PIECE_SELECTOR: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 3, 8 + color);
+    case PIECE_SPLICER: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 5, 8 + color);
+    case PIECE_COLOR_SHIFTER: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 2, 6);
+    case PIECE_COLOR_INVERTER: return PieceGfx(orientation, PieceGfx::Mode::HAS_HALF_ROTATION, 0, 6);
 
     case PIECE_TNT: gfx = Position(15, 7); break;
 
@@ -141,18 +144,22 @@ PieceGfx LevelView::gfxForPiece(const Piece* piece)
     case PIECE_TELEPORTER: gfx = Position(9, 7); break;
     case PIECE_SLIME: gfx = Position(8, 7); break;
     case PIECE_MINE: gfx = Position(8, 8); break;
-    case PIECE_STRICT_GOAL: gfx = Position(color + 8, static_cast<const Goal*>(piece)->isSatisfied() ? 14 : 13); break;
+    case PIECE_STRICT_GOAL: gfx = Position(color + 8, satisfied ? 14 : 13); break;
       
     default:
       assert(false);
   }
   
-  return PieceGfx(gfx.x, gfx.y, piece->orientation());
+  return PieceGfx(gfx.x, gfx.y, orientation);
 }
 
 void LevelView::drawPiece(const Piece* piece, int cx, int cy)
 {
-  PieceGfx src = gfxForPiece(piece);
+  drawPiece(gfxForPiece(piece), cx, cy);
+}
+
+void LevelView::drawPiece(const PieceGfx& src, int cx, int cy)
+{
   SDL_Rect dst = Gfx::ccr(cx + 1, cy + 1, ui::PIECE_SIZE, ui::PIECE_SIZE);
 
   //TODO: verify if this is fine and don't rotate for unrotable pieces
@@ -162,16 +169,18 @@ void LevelView::drawPiece(const Piece* piece, int cx, int cy)
 
 void LevelView::drawField(const Field *field, int bx, int by)
 {  
+  const Board& board = field->board();
+  
   for (u32 x = 0; x < field->width(); ++x)
     for (u32 y = 0; y < field->height(); ++y)
     {
-      const Tile *tile = field->tileAt(Position(x, y));
+      const u32 index = y*field->width() + x;
       
       u32 cx = bx + x*ui::TILE_SIZE;
       u32 cy = by + y*ui::TILE_SIZE;
       
-      if (tile->piece())
-        drawPiece(tile->piece().get(), cx, cy);
+      if (!board.empty(index))
+        drawPiece(gfxForPiece(board.types[index], static_cast<Direction>(board.rotations[index]), board.colors[index], board.flags[index] & Board::SATISFIED), cx, cy);
       
       static SDL_Rect rect = { 224, 16, 4, 1 };
       static SDL_Rect dst = { 0, 0, 4, 8 };
@@ -198,12 +207,14 @@ void LevelView::drawField(const Field *field, int bx, int by)
       SDL_SetTextureBlendMode(Gfx::tiles, SDL_BLENDMODE_BLEND);
       for (int i = 0; i < 8; ++i)
       {
-        if (tile->colors[i] != LaserColor::NONE)
+        const LaserColor color = Board::laserColor(board.lasers[index], i);
+        
+        if (color != LaserColor::NONE)
         {
           dst.x = (int)cx + specs[i].dx;
           dst.y = (int)cy + specs[i].dy;
           dst.h = specs[i].length;
-          rect.y = 8 + 8*tile->colors[i];
+          rect.y = 8 + 8*color;
           
           SDL_RenderCopyEx(Gfx::renderer, Gfx::tiles, &rect, &dst, specs[i].angle, nullptr, SDL_FLIP_NONE);
 
@@ -224,7 +235,7 @@ void LevelView::drawInventory(const Field* field, int bx, int by)
       
       if (tile->piece())
       {
-        PieceGfx src = gfxForPiece(tile->piece().get());
+        PieceGfx src = gfxForPiece(tile->piece());
         SDL_Rect dst = Gfx::ccr(bx+ui::TILE_SIZE*x + 1, by + ui::TILE_SIZE*y + 1, ui::PIECE_SIZE, ui::PIECE_SIZE);
         Gfx::blit(Gfx::tiles, src.rect, dst);
       }
@@ -307,7 +318,7 @@ void LevelView::draw()
   drawInventory(field, inventoryBaseX, GFX_FIELD_POS_Y);
   
   if (field->level())
-    Gfx::drawString(GFX_FIELD_POS_X + field->width()*ui::TILE_SIZE/2, 5, true, field->level()->name + (field->level()->solved ? " \x1D" : ""));
+    Gfx::drawString(GFX_FIELD_POS_X + field->width()*ui::TILE_SIZE/2, 5, true, std::string(field->level()->name()) + (field->level()->solved ? " \x1D" : ""));
 
   // 245, 110
   
@@ -341,8 +352,8 @@ void LevelView::draw()
     Gfx::drawString(BASE_X + 40, BASE_Y + STEP, true, "A: rotate right");
   }
   
-  if (heldPiece) 
-    drawPiece(heldPiece.get(), x - ui::PIECE_SIZE / 2, y - ui::PIECE_SIZE / 2);
+  if (!heldPiece.empty()) 
+    drawPiece(&heldPiece, x - ui::PIECE_SIZE / 2, y - ui::PIECE_SIZE / 2);
 
   if (curTile->piece())
   {
@@ -409,22 +420,23 @@ void LevelView::handleMouseEvent(EventType type, int x, int y, int button)
       
       if (button == SDL_BUTTON_LEFT)
       {
-        if (!heldPiece && piece && piece->canBeMoved())
+        if (heldPiece.empty() && piece && piece->canBeMoved())
         {
           if (piece->isInfinite())
           {
-            Piece* dupe = piece->dupe();
-            dupe->setInfinite(false);
-            heldPiece.reset(dupe);
+            heldPiece = *piece;
+            heldPiece.setInfinite(false);
           }
           else
             tile->swap(heldPiece);
 
+          field->invalidate(hover);
           levelChanged();
         }
-        else if (heldPiece && (!piece || piece->canBeMoved()))
+        else if (!heldPiece.empty() && (!piece || piece->canBeMoved()))
         {
           tile->swap(heldPiece);
+          field->invalidate(hover);
           levelChanged();
         }
       }
@@ -433,6 +445,7 @@ void LevelView::handleMouseEvent(EventType type, int x, int y, int button)
         if (piece && piece->canBeRotated())
         {
           piece->rotateRight();
+          field->invalidate(hover);
           levelChanged();
         }
       }
@@ -463,7 +476,7 @@ void LevelView::handleEvent(SDL_Event &event)
         {
           const auto& piece = field->tileAt(*position)->piece();
 
-          if (piece.get() && piece->canBeColored())
+          if (piece && piece->canBeColored())
           {
             LaserColor channel = key == SDLK_z ? LaserColor::RED : (key == SDLK_x ? LaserColor::GREEN : LaserColor::BLUE);
             LaserColor color = piece->color();
@@ -472,6 +485,7 @@ void LevelView::handleEvent(SDL_Event &event)
             else color = (LaserColor)(color | channel);
 
             piece->setColor(color);
+            field->invalidate(*position);
             levelChanged();
           }
 
@@ -554,6 +568,8 @@ void LevelView::handleEvent(SDL_Event &event)
             if (!newPiece || newPiece->canBeMoved())
             {
               selectedTile->swap(curTile);
+              field->invalidate(field->positionOf(selectedTile));
+              field->invalidate(*position);
               selectedTile = nullptr;    
               levelChanged();
             }
@@ -567,6 +583,7 @@ void LevelView::handleEvent(SDL_Event &event)
           if (piece && piece->canBeRotated())
           {
             piece->rotateLeft();
+            field->invalidate(*position);
             levelChanged();
           }
           
@@ -20,7 +20,7 @@ struct PieceGfx;
 class LevelView : public View
 {
 private:
-  std::unique_ptr<Piece> heldPiece;
+  Piece heldPiece;
   Tile* selectedTile;
   Position fposition, iposition;
   Position *position;
@@ -28,6 +28,7 @@ private:
   u16 coordX(const Position& p);
   u16 coordY(const Position& p);
   static PieceGfx gfxForPiece(const Piece* piece);
+  static PieceGfx gfxForPiece(PieceType type, Direction orientation, LaserColor color, bool satisfied);
   
   Field* field() { return game->field; }
   
@@ -35,7 +36,7 @@ private:
   void levelChanged();
 
 public:
-  LevelView(Game *game) : View(game), selectedTile(nullptr), fposition(Position(0,0)), iposition(Position(Position::Type::INVENTORY,0,0)), position(&fposition), heldPiece(nullptr) { }
+  LevelView(Game *game) : View(game), selectedTile(nullptr), fposition(Position(0,0)), iposition(Position(Position::Type::INVENTORY,0,0)), position(&fposition), heldPiece() { }
   void handleEvent(SDL_Event &event);
   void draw();
   void activate();
@@ -50,6 +51,7 @@ public:
   static void drawTooltip(int x, int y, const std::string& text);
 
   static void drawPiece(const Piece* piece, int x, int y);
+  static void drawPiece(const PieceGfx& gfx, int x, int y);
 };
 
 #endif
@@ -41,9 +41,9 @@ void LevelSelectView::draw()
 
   for (int i = 0; levelList.hasNext(i) && i < ui::LIST_SIZE; ++i)
   {
-    const LevelSpec* spec = levelList.get(i);
+    const LevelRef spec = levelList.get(i);
     
-    Gfx::drawString(ui::LIST_X, ui::LIST_Y+ ui::LIST_DY*i, false, "%s%s", spec->name.c_str(), spec->solved ? " \x1D" : "");
+    Gfx::drawString(ui::LIST_X, ui::LIST_Y+ ui::LIST_DY*i, false, "%.*s%s", static_cast<int>(spec->name().length()), spec->name().data(), spec->solved ? " \x1D" : "");
     
     if (levelList.isSelected(i))
       Gfx::blit(Gfx::ui, 0, 0, 4, 7, ui::LIST_X-8, ui::LIST_Y+ ui::LIST_DY*i);
@@ -144,8 +144,11 @@ void LevelSelectView::handleEvent(SDL_Event &event)
 
 void LevelSelectView::rebuildPreview()
 {
+  const LevelRef level = game->pack->at(game->pack->selected);
+  printf("Loading %.*s\n", static_cast<int>(level->name().length()), level->name().data());
+  
   field->reset();
-  field->load(game->pack->at(game->pack->selected));
+  field->load(level);
   
   Gfx::setTarget(preview);
   Gfx::clear(BACKGROUND_COLOR);
@@ -15,7 +15,7 @@ struct SDL_Texture;
 
 class View;
 
-class LevelList : public OffsettableList<const LevelSpec*>
+class LevelList : public OffsettableList<LevelRef>
 {
   private:
     Game *game;
@@ -26,7 +26,7 @@ class LevelList : public OffsettableList<const LevelSpec*>
     size_t current() const { return game->pack->selected; }
     size_t count() const { return game->pack->count(); }
     void set(size_t i) { game->pack->selected = i; }
-    const LevelSpec* get(size_t i) const { return game->pack->at(offset+i); }
+    LevelRef get(size_t i) const { return game->pack->at(offset+i); }
 };
 
 class LevelSelectView : public View
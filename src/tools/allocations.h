@@ -0,0 +1,46 @@
+#pragma once
+
+#include "common/common.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/* counts heap allocations made through the global operator new, which is replaced below: only a single source of a
+   tool may include this header, the library and the game keep the default allocator */
+class Allocations
+{
+private:
+  static inline std::atomic<size_t> allocations{0};
+
+public:
+  static size_t count() { return allocations.load(std::memory_order_relaxed); }
+  static void add() { allocations.fetch_add(1, std::memory_order_relaxed); }
+
+  class Scope
+  {
+  private:
+    size_t start;
+
+  public:
+    Scope() : start(Allocations::count()) { }
+    size_t count() const { return Allocations::count() - start; }
+  };
+};
+
+void* operator new(size_t size)
+{
+  Allocations::add();
+
+  if (void* ptr = std::malloc(size ? size : 1))
+    return ptr;
+
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
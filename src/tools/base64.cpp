@@ -0,0 +1,110 @@
+#include "files/files.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+/* times Files::encode and Files::decode with each base64 kernel the cpu supports, on buffers of the size
+   of a .pak line and on large buffers, and checks that every kernel gives the output of the scalar one */
+
+using clock_type = std::chrono::steady_clock;
+
+struct Options
+{
+  size_t small = 96;
+  size_t large = 1 << 20;
+  size_t bytes = size_t(256) << 20;
+};
+
+static const char* kernelName(Files::Base64Kernel kernel)
+{
+  switch (kernel)
+  {
+    case Files::Base64Kernel::SCALAR: return "scalar";
+    case Files::Base64Kernel::SSSE3: return "ssse3";
+    case Files::Base64Kernel::AVX2: return "avx2";
+  }
+
+  return "";
+}
+
+/* MB/s of the input processed, the buffer is processed again until the given amount of bytes is reached */
+template<typename F> static double throughput(size_t length, size_t bytes, F f)
+{
+  const size_t iterations = std::max<size_t>(1, bytes / std::max<size_t>(1, length));
+
+  auto start = clock_type::now();
+  for (size_t i = 0; i < iterations; ++i)
+    f();
+  const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+  return seconds > 0 ? (iterations * length) / seconds / (1 << 20) : 0.0;
+}
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "usage: %s [-s small bytes] [-l large bytes] [-b total bytes]\n", name);
+  exit(1);
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (i + 1 >= argc)
+      usage(argv[0]);
+    else if (!strcmp(argv[i], "-s"))
+      options.small = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-l"))
+      options.large = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-b"))
+      options.bytes = size_t(std::max(1, atoi(argv[++i]))) << 20;
+    else
+      usage(argv[0]);
+  }
+
+  std::mt19937 random(42);
+  std::vector<u8> input(options.large);
+  std::generate(input.begin(), input.end(), [&random] () { return static_cast<u8>(random()); });
+
+  std::vector<char> text(Files::encodedLength(input.size()));
+  std::vector<char> reference(text.size());
+  std::vector<u8> output(Files::decodedLength(text.size()));
+
+  Files::useBase64Kernel(Files::Base64Kernel::SCALAR);
+  Files::encode(input.data(), input.size(), reference.data());
+
+  printf("kernel, encode %zu B, decode %zu B, encode %zu B, decode %zu B (MB/s)\n", options.small, options.small, options.large, options.large);
+
+  for (Files::Base64Kernel kernel : { Files::Base64Kernel::SCALAR, Files::Base64Kernel::SSSE3, Files::Base64Kernel::AVX2 })
+  {
+    if (!Files::useBase64Kernel(kernel))
+      continue;
+
+    Files::encode(input.data(), input.size(), text.data());
+    const size_t decoded = Files::decode(reference.data(), reference.size(), output.data());
+
+    if (text != reference || decoded != input.size() || !std::equal(input.begin(), input.end(), output.begin()))
+    {
+      fprintf(stderr, "%s kernel doesn't match the scalar one\n", kernelName(kernel));
+      return 1;
+    }
+
+    const size_t smallText = Files::encodedLength(options.small);
+
+    const double smallEncode = throughput(options.small, options.bytes, [&] () { Files::encode(input.data(), options.small, text.data()); });
+    const double smallDecode = throughput(smallText, options.bytes, [&] () { Files::decode(reference.data(), smallText, output.data()); });
+    const double largeEncode = throughput(input.size(), options.bytes, [&] () { Files::encode(input.data(), input.size(), text.data()); });
+    const double largeDecode = throughput(reference.size(), options.bytes, [&] () { Files::decode(reference.data(), reference.size(), output.data()); });
+
+    printf("%s, %.0f, %.0f, %.0f, %.0f\n", kernelName(kernel), smallEncode, smallDecode, largeEncode, largeDecode);
+  }
+
+  return 0;
+}
@@ -0,0 +1,140 @@
+#include "core/batch.h"
+#include "files/aargon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/* builds the boards of a placement preview for every Aargon level, each inventory piece on each empty tile, and times
+   evaluating them one by one with an incremental Field against BatchTracer, the outcomes of both must be the same */
+
+using clock_type = std::chrono::steady_clock;
+
+static constexpr u32 WIDTH = 16, HEIGHT = 11, INV_WIDTH = 4, INV_HEIGHT = 11;
+
+struct Options
+{
+  u32 repeats = 20;
+};
+
+static bool fits(const Field& field, const LevelSpec* level)
+{
+  for (size_t i = 0; i < level->count(); ++i)
+  {
+    const PieceInfo& info = level->at(i);
+    if (!info.inventory && !field.isInside(Position(info.x, info.y)))
+      return false;
+  }
+
+  return true;
+}
+
+static void buildPreview(const FieldState& base, std::vector<FieldState>& states)
+{
+  const size_t tiles = WIDTH*HEIGHT;
+  states.clear();
+
+  for (size_t slot = tiles; slot < base.pieces.size(); ++slot)
+  {
+    if (base.pieces[slot].empty())
+      continue;
+
+    for (size_t tile = 0; tile < tiles; ++tile)
+    {
+      if (!base.pieces[tile].empty())
+        continue;
+
+      states.push_back(base);
+      std::swap(states.back().pieces[tile], states.back().pieces[slot]);
+    }
+  }
+}
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "usage: %s [-r repeats]\n", name);
+  exit(1);
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (i + 1 >= argc)
+      usage(argv[0]);
+    else if (!strcmp(argv[i], "-r"))
+      options.repeats = std::max(1, atoi(argv[++i]));
+    else
+      usage(argv[0]);
+  }
+
+  std::vector<LevelPack> packs = Aargon::loadLevels();
+  Field field(WIDTH, HEIGHT, INV_WIDTH, INV_HEIGHT);
+  BatchTracer tracer(WIDTH, HEIGHT, INV_WIDTH, INV_HEIGHT);
+  field.setIncremental(true);
+
+  std::vector<FieldState> states;
+  std::vector<BatchResult> serial, batched;
+  FieldState base;
+
+  double serialSeconds = 0.0, batchSeconds = 0.0;
+  size_t boards = 0, mismatches = 0;
+
+  for (const LevelPack& pack : packs)
+    for (u32 i = 0; i < pack.count(); ++i)
+    {
+      const LevelRef level = pack.at(i);
+
+      if (!fits(field, level.get()))
+        continue;
+
+      field.reset();
+      field.load(level);
+      field.snapshot(base);
+      buildPreview(base, states);
+
+      serial.resize(states.size());
+
+      auto start = clock_type::now();
+      for (u32 r = 0; r < options.repeats; ++r)
+        for (size_t s = 0; s < states.size(); ++s)
+        {
+          field.restore(states[s]);
+          serial[s].won = field.isWon();
+          serial[s].failing = field.isFailing();
+          serial[s].satisfied = static_cast<u32>(std::count_if(field.goalStates().begin(), field.goalStates().end(), [] (const GoalState& goal) { return goal.satisfied; }));
+        }
+      serialSeconds += std::chrono::duration<double>(clock_type::now() - start).count();
+
+      start = clock_type::now();
+      for (u32 r = 0; r < options.repeats; ++r)
+        tracer.evaluate(states, batched);
+      batchSeconds += std::chrono::duration<double>(clock_type::now() - start).count();
+
+      for (size_t s = 0; s < states.size(); ++s)
+      {
+        const BatchResult& a = serial[s], &b = batched[s];
+
+        if (a.won != b.won || a.failing != b.failing || a.satisfied != b.satisfied)
+        {
+          if (!mismatches)
+            fprintf(stderr, "%s %.*s board %zu differs\n", pack.name().c_str(), static_cast<int>(level->name().length()), level->name().data(), s);
+          ++mismatches;
+        }
+      }
+
+      boards += states.size();
+    }
+
+  const double evaluations = double(boards) * options.repeats;
+  printf("%zu boards, serial %.0f boards/s, batch %.0f boards/s (%.1fx), %zu mismatches\n", boards,
+         serialSeconds > 0 ? evaluations / serialSeconds : 0.0, batchSeconds > 0 ? evaluations / batchSeconds : 0.0,
+         batchSeconds > 0 ? serialSeconds / batchSeconds : 0.0, mismatches);
+
+  return mismatches ? 1 : 0;
+}
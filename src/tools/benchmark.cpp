@@ -0,0 +1,258 @@
+#include "core/level.h"
+#include "files/aargon.h"
+#include "tools/allocations.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+/* times Field::load and Field::updateLasers() on every Aargon level and on synthetic boards,
+   one CSV row per board is written to the output file so that runs can be compared. Repeated updates
+   of an unchanged field must not allocate, the tool fails when one does. With packed channels every board
+   is also traced with exact colors and the tool fails when the lasers, goals or failures differ */
+
+using clock_type = std::chrono::steady_clock;
+
+struct Options
+{
+  const char* output = "benchmark.csv";
+  u32 loads = 100;
+  u32 updates = 1000;
+  u32 dummies = 16;
+  bool bitboard = false;
+  bool staticScene = false;
+  bool packedChannels = false;
+};
+
+struct Result
+{
+  double loadNs;
+  double updateNs;
+  u32 beams;
+  size_t loadAllocations;
+  size_t updateAllocations;
+  /* any of the measured updates allocated, even less than once per update */
+  bool allocating;
+};
+
+static constexpr u32 WIDTH = 16, HEIGHT = 11, INV_WIDTH = 4, INV_HEIGHT = 11;
+
+static double elapsedNs(clock_type::time_point start, u32 iterations)
+{
+  return std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / iterations;
+}
+
+static Result measureUpdates(Field& field, const Options& options)
+{
+  Result result = { 0, 0, 0, 0, 0, false };
+
+  field.updateLasers();
+  result.beams = field.tracedBeams();
+
+  Allocations::Scope allocations;
+  auto start = clock_type::now();
+  for (u32 i = 0; i < options.updates; ++i)
+    field.updateLasers();
+  result.updateNs = elapsedNs(start, options.updates);
+  result.updateAllocations = allocations.count() / options.updates;
+  result.allocating = allocations.count() != 0;
+
+  return result;
+}
+
+static Result measureLevel(Field& field, const LevelRef& level, const Options& options)
+{
+  field.reset();
+  field.load(level);
+
+  Allocations::Scope allocations;
+  auto start = clock_type::now();
+  for (u32 i = 0; i < options.loads; ++i)
+  {
+    field.reset();
+    field.load(level);
+  }
+  const double loadNs = elapsedNs(start, options.loads);
+  const size_t loadAllocations = allocations.count() / options.loads;
+
+  Result result = measureUpdates(field, options);
+  result.loadNs = loadNs;
+  result.loadAllocations = loadAllocations;
+  return result;
+}
+
+/* fills the field with copies of the pieces that generateDummy() puts in the inventory */
+static void buildDummy(Field& field, u32 seed)
+{
+  std::mt19937 rng(seed);
+
+  field.generateDummy();
+
+  u32 pieces = 0;
+  while (pieces < INV_WIDTH*INV_HEIGHT && field.tileAt(Position(Position::Type::INVENTORY, pieces % INV_WIDTH, pieces / INV_WIDTH))->piece())
+    ++pieces;
+
+  for (u32 y = 0; y < HEIGHT; ++y)
+    for (u32 x = 0; x < WIDTH; ++x)
+    {
+      if (rng() % 2)
+        continue;
+
+      const u32 slot = rng() % pieces;
+      Piece piece = *field.tileAt(Position(Position::Type::INVENTORY, slot % INV_WIDTH, slot / INV_WIDTH))->piece();
+      const PieceMechanics* mechanics = PieceMechanics::mechanicsForType(piece.type());
+
+      piece.setInfinite(false);
+      if (mechanics->canBeRotated())
+        piece.setOrientation(static_cast<Direction>(rng() % 8));
+      if (mechanics->canBeColored())
+        piece.setColor(static_cast<LaserColor>(1 + rng() % 7));
+
+      field.place(Position(x, y), piece);
+    }
+}
+
+/* same outcome as tracing with exact colors, only meaningful right after an update of both fields */
+static bool sameOutcome(const Field& field, const Field& reference)
+{
+  if (field.board().lasers != reference.board().lasers || field.isFailing() != reference.isFailing() ||
+      field.goalStates().size() != reference.goalStates().size())
+    return false;
+
+  for (size_t i = 0; i < field.goalStates().size(); ++i)
+  {
+    const GoalState& goal = field.goalStates()[i], &expected = reference.goalStates()[i];
+
+    if (goal.index != expected.index || goal.directions != expected.directions || goal.colors != expected.colors || goal.satisfied != expected.satisfied)
+      return false;
+  }
+
+  return true;
+}
+
+static void writeRow(FILE* out, const std::string& pack, const std::string& level, const Options& options, const Result& result)
+{
+  fprintf(out, "\"%s\",\"%s\",%u,%.1f,%u,%.1f,%u,%zu,%zu\n", pack.c_str(), level.c_str(),
+          options.loads, result.loadNs, options.updates, result.updateNs, result.beams,
+          result.loadAllocations, result.updateAllocations);
+}
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "usage: %s [-o output.csv] [-l loads] [-u updates] [-d dummies] [-e scalar|bitboard] [-s off|on] [-c exact|packed]\n", name);
+  exit(1);
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (i + 1 >= argc)
+      usage(argv[0]);
+    else if (!strcmp(argv[i], "-o"))
+      options.output = argv[++i];
+    else if (!strcmp(argv[i], "-l"))
+      options.loads = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-u"))
+      options.updates = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-d"))
+      options.dummies = std::max(0, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-e") && !strcmp(argv[i + 1], "scalar"))
+      options.bitboard = false, ++i;
+    else if (!strcmp(argv[i], "-e") && !strcmp(argv[i + 1], "bitboard"))
+      options.bitboard = true, ++i;
+    else if (!strcmp(argv[i], "-s") && !strcmp(argv[i + 1], "off"))
+      options.staticScene = false, ++i;
+    else if (!strcmp(argv[i], "-s") && !strcmp(argv[i + 1], "on"))
+      options.staticScene = true, ++i;
+    else if (!strcmp(argv[i], "-c") && !strcmp(argv[i + 1], "exact"))
+      options.packedChannels = false, ++i;
+    else if (!strcmp(argv[i], "-c") && !strcmp(argv[i + 1], "packed"))
+      options.packedChannels = true, ++i;
+    else
+      usage(argv[0]);
+  }
+
+  FILE* out = fopen(options.output, "w");
+
+  if (!out)
+  {
+    fprintf(stderr, "can't open %s\n", options.output);
+    return 1;
+  }
+
+  fprintf(out, "pack,level,loads,load_ns,updates,update_ns,beams,load_allocations,update_allocations\n");
+
+  std::vector<LevelPack> packs = Aargon::loadLevels();
+  Field field(WIDTH, HEIGHT, INV_WIDTH, INV_HEIGHT);
+  field.setBitboard(options.bitboard);
+  field.setStaticScene(options.staticScene);
+  field.setPackedChannels(options.packedChannels);
+  Field reference(WIDTH, HEIGHT, INV_WIDTH, INV_HEIGHT);
+
+  double totalNs = 0.0;
+  u64 totalBeams = 0;
+  u32 measured = 0, allocating = 0, mismatches = 0;
+
+  auto compare = [&] (const std::string& pack, const std::string& name) {
+    if (!options.packedChannels)
+      return;
+
+    reference.updateLasers();
+
+    if (!sameOutcome(field, reference) && mismatches++ == 0)
+      fprintf(stderr, "%s %s differs from tracing with exact colors\n", pack.c_str(), name.c_str());
+  };
+
+  for (const LevelPack& pack : packs)
+    for (u32 i = 0; i < pack.count(); ++i)
+    {
+      const LevelRef level = pack.at(i);
+      Result result = measureLevel(field, level, options);
+      writeRow(out, pack.name(), std::string(level->name()), options, result);
+
+      reference.reset();
+      reference.load(level);
+      compare(pack.name(), std::string(level->name()));
+
+      if (result.allocating && allocating++ == 0)
+        fprintf(stderr, "%s %s allocates while updating\n", pack.name().c_str(), std::string(level->name()).c_str());
+      totalNs += result.updateNs;
+      totalBeams += result.beams;
+      ++measured;
+    }
+
+  // synthetic boards aren't loaded from a LevelSpec
+  Options dummyOptions = options;
+  dummyOptions.loads = 0;
+
+  for (u32 i = 0; i < options.dummies; ++i)
+  {
+    buildDummy(field, i);
+
+    Result result = measureUpdates(field, options);
+    writeRow(out, "dummy", std::to_string(i), dummyOptions, result);
+
+    buildDummy(reference, i);
+    compare("dummy", std::to_string(i));
+
+    if (result.allocating && allocating++ == 0)
+      fprintf(stderr, "dummy %u allocates while updating\n", i);
+    totalNs += result.updateNs;
+    totalBeams += result.beams;
+    ++measured;
+  }
+
+  fclose(out);
+
+  printf("measured %u boards, mean %.1f ns/update, %llu traced beams, %u allocating, %u mismatches, results in %s\n", measured,
+         measured ? totalNs / measured : 0.0, static_cast<unsigned long long>(totalBeams), allocating, mismatches, options.output);
+
+  return allocating || mismatches ? 1 : 0;
+}
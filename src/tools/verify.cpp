@@ -0,0 +1,269 @@
+#include "core/simulator.h"
+#include "files/aargon.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/* replays solutions on the Aargon levels and writes whether each one wins, one CSV row per solution.
+   Input rows are "pack","level",...,"placements", the last column is read as the placements so that
+   the output of the solver tool can be verified as is. */
+
+using clock_type = std::chrono::steady_clock;
+
+enum class Verdict : u8
+{
+  PASS,
+  UNKNOWN_LEVEL,
+  INVALID_LEVEL,
+  MALFORMED,
+  ILLEGAL_MOVE,
+  NOT_WON,
+  FAILING
+};
+
+static const char* verdictName(Verdict verdict)
+{
+  switch (verdict)
+  {
+    case Verdict::PASS: return "pass";
+    case Verdict::UNKNOWN_LEVEL: return "unknown_level";
+    case Verdict::INVALID_LEVEL: return "invalid_level";
+    case Verdict::MALFORMED: return "malformed";
+    case Verdict::ILLEGAL_MOVE: return "illegal_move";
+    case Verdict::NOT_WON: return "not_won";
+    case Verdict::FAILING: return "failing";
+  }
+
+  return "";
+}
+
+struct Submission
+{
+  size_t line;
+  std::string pack;
+  std::string level;
+  std::string placements;
+};
+
+struct Result
+{
+  Verdict verdict;
+  /* index of the first placement which couldn't be applied */
+  u32 move;
+};
+
+/* splits a CSV row, quoted fields may contain commas and "" for a quote */
+static void splitRow(const std::string& row, std::vector<std::string>& fields)
+{
+  fields.clear();
+  fields.emplace_back();
+
+  bool quoted = false;
+
+  for (size_t i = 0; i < row.size(); ++i)
+  {
+    const char c = row[i];
+
+    if (quoted && c == '"' && i + 1 < row.size() && row[i + 1] == '"')
+      fields.back() += row[++i];
+    else if (c == '"')
+      quoted = !quoted;
+    else if (c == ',' && !quoted)
+      fields.emplace_back();
+    else if (c != '\r' && c != '\n')
+      fields.back() += c;
+  }
+}
+
+/* quotes a CSV field the way splitRow reads it back */
+static std::string quoteField(const std::string& field)
+{
+  std::string quoted = "\"";
+
+  for (char c : field)
+  {
+    if (c == '"')
+      quoted += '"';
+    quoted += c;
+  }
+
+  return quoted + '"';
+}
+
+static std::vector<Submission> readSubmissions(FILE* in)
+{
+  std::vector<Submission> submissions;
+  std::vector<std::string> fields;
+  std::string row;
+  char buffer[4096];
+  size_t line = 0;
+
+  while (fgets(buffer, sizeof(buffer), in))
+  {
+    row += buffer;
+
+    // long rows are read in several chunks
+    if (row.back() != '\n' && !feof(in))
+      continue;
+
+    ++line;
+    splitRow(row, fields);
+    row.clear();
+
+    if ((line == 1 && fields[0] == "pack") || (fields.size() == 1 && fields[0].empty()))
+      continue;
+
+    submissions.push_back({ line, fields[0], fields.size() > 1 ? fields[1] : "", fields.size() > 2 ? fields.back() : "" });
+  }
+
+  return submissions;
+}
+
+static std::string levelKey(const std::string& pack, const std::string& level)
+{
+  return pack + '\n' + level;
+}
+
+static Result verify(Simulator& simulator, const LevelRef& level, const Submission& submission, std::vector<Placement>& placements)
+{
+  if (!level)
+    return { Verdict::UNKNOWN_LEVEL, 0 };
+  else if (!Simulator::parsePlacements(submission.placements, placements))
+    return { Verdict::MALFORMED, 0 };
+  else if (!simulator.load(level))
+    return { Verdict::INVALID_LEVEL, 0 };
+
+  for (u32 i = 0; i < placements.size(); ++i)
+    if (!simulator.apply(placements[i]))
+      return { Verdict::ILLEGAL_MOVE, i };
+
+  simulator.update();
+
+  if (simulator.field().isFailing())
+    return { Verdict::FAILING, 0 };
+  else if (!simulator.isWon())
+    return { Verdict::NOT_WON, 0 };
+  else
+    return { Verdict::PASS, 0 };
+}
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "usage: %s [-i solutions.csv] [-o output.csv] [-t threads]\n", name);
+  exit(1);
+}
+
+int main(int argc, char** argv)
+{
+  const char* input = "-";
+  const char* output = "verification.csv";
+  u32 threads = 0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (i + 1 >= argc)
+      usage(argv[0]);
+    else if (!strcmp(argv[i], "-i"))
+      input = argv[++i];
+    else if (!strcmp(argv[i], "-o"))
+      output = argv[++i];
+    else if (!strcmp(argv[i], "-t"))
+      threads = std::max(0, atoi(argv[++i]));
+    else
+      usage(argv[0]);
+  }
+
+  if (!threads)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  FILE* in = strcmp(input, "-") ? fopen(input, "r") : stdin;
+
+  if (!in)
+  {
+    fprintf(stderr, "can't open %s\n", input);
+    return 1;
+  }
+
+  const std::vector<Submission> submissions = readSubmissions(in);
+
+  if (in != stdin)
+    fclose(in);
+
+  std::vector<LevelPack> packs = Aargon::loadLevels();
+  std::unordered_map<std::string, LevelRef> levels;
+
+  for (const LevelPack& pack : packs)
+    for (u32 i = 0; i < pack.count(); ++i)
+      levels.emplace(levelKey(pack.name(), std::string(pack.at(i)->name())), pack.at(i));
+
+  std::vector<LevelRef> specs(submissions.size());
+  for (size_t i = 0; i < submissions.size(); ++i)
+  {
+    auto it = levels.find(levelKey(submissions[i].pack, submissions[i].level));
+    specs[i] = it != levels.end() ? it->second : LevelRef();
+  }
+
+  std::vector<Result> results(submissions.size());
+  std::atomic<size_t> next(0);
+
+  // threads take solutions in small batches, each one reuses its own simulator
+  auto work = [&] () {
+    static constexpr size_t BATCH = 64;
+
+    Simulator simulator;
+    std::vector<Placement> placements;
+
+    for (size_t start = next.fetch_add(BATCH); start < submissions.size(); start = next.fetch_add(BATCH))
+      for (size_t i = start; i < std::min(start + BATCH, submissions.size()); ++i)
+        results[i] = verify(simulator, specs[i], submissions[i], placements);
+  };
+
+  auto start = clock_type::now();
+
+  std::vector<std::thread> pool;
+  for (u32 i = 1; i < threads; ++i)
+    pool.emplace_back(work);
+  work();
+  for (std::thread& thread : pool)
+    thread.join();
+
+  const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+  FILE* out = fopen(output, "w");
+
+  if (!out)
+  {
+    fprintf(stderr, "can't open %s\n", output);
+    return 1;
+  }
+
+  fprintf(out, "line,pack,level,result,move\n");
+
+  size_t passed = 0;
+
+  for (size_t i = 0; i < submissions.size(); ++i)
+  {
+    const Result& result = results[i];
+
+    fprintf(out, "%zu,%s,%s,%s,", submissions[i].line, quoteField(submissions[i].pack).c_str(), quoteField(submissions[i].level).c_str(), verdictName(result.verdict));
+    if (result.verdict == Verdict::ILLEGAL_MOVE)
+      fprintf(out, "%u", result.move);
+    fprintf(out, "\n");
+
+    passed += result.verdict == Verdict::PASS;
+  }
+
+  fclose(out);
+
+  printf("verified %zu solutions, %zu passed, %zu failed in %.2f s (%.0f solutions/s on %u threads), results in %s\n",
+         submissions.size(), passed, submissions.size() - passed, seconds, seconds > 0 ? submissions.size() / seconds : 0.0, threads, output);
+
+  return 0;
+}